@@ -1114,10 +1114,411 @@ void test26()
             ); 
 }
 
+#include <numeric> // std::accumulate
+void test27() // iterators
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    const int asize = 4;
+    Lariat<int, asize> lar;
+    for( int i = 1; i <= 10; ++i ) {
+        lar.push_back( i );
+    }
+    lar.insert( 5, 42 ); // split a node in the middle
+    lar.erase( 0 );
+
+    std::cout << "for_each:";
+    std::for_each( lar.begin(), lar.end(), []( int value ) { std::cout << " " << value; } );
+    std::cout << "\nsum: " << std::accumulate( lar.cbegin(), lar.cend(), 0 ) << std::endl;
+
+    std::cout << "reversed:";
+    for ( Lariat<int, asize>::const_reverse_iterator it = lar.rbegin(); it != lar.rend(); ++it ) {
+        std::cout << " " << *it;
+    }
+    std::cout << std::endl;
+
+    Lariat<int, asize>::iterator it = lar.begin() + 7;
+    std::cout << "begin + 7: " << *it << ", back 5: " << it[-5]
+              << ", distance: " << ( it - lar.begin() ) << " " << ( lar.begin() - it )
+              << ", size: " << ( lar.end() - lar.begin() ) << std::endl;
+
+    std::sort( lar.begin(), lar.end(), std::greater<int>() );
+    for ( Lariat<int, asize>::iterator i = lar.begin(); i != lar.end(); ++i ) {
+        *i *= 10;
+    }
+    std::cout << lar << std::endl;
+
+    Lariat<int, asize> empty;
+    std::cout << "empty: " << ( empty.begin() == empty.end() ) << std::endl;
+}
+// counts the copies made of it
+struct Tracked
+{
+    static int copies;
+    std::string text;
+
+    Tracked() {}
+    Tracked( const std::string& t ) : text( t ) {}
+    Tracked( const char* t, int repeat ) { while ( repeat-- > 0 ) text += t; }
+    Tracked( const Tracked& rhs ) : text( rhs.text ) { ++copies; }
+    Tracked( Tracked&& rhs ) noexcept : text( std::move( rhs.text ) ) {}
+    Tracked& operator=( const Tracked& rhs ) { text = rhs.text; ++copies; return *this; }
+    Tracked& operator=( Tracked&& rhs ) noexcept { text = std::move( rhs.text ); return *this; }
+};
+int Tracked::copies = 0;
+
+std::ostream& operator<<( std::ostream& os, const Tracked& t )
+{
+    return os << t.text;
+}
+
+Lariat<Tracked, 3> make_lariat()
+{
+    Lariat<Tracked, 3> lar;
+    for ( int i = 0; i < 5; ++i ) {
+        lar.emplace_back( "ab", i + 1 );
+    }
+    return lar;
+}
+
+void test28() // move semantics and emplace
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<Tracked, 3> lar( make_lariat() );
+    lar.emplace( 2, "x", 3 );
+    lar.emplace_front( "front" );
+    lar.push_back( Tracked( "moved in" ) );
+    Tracked kept( "kept" );
+    lar.insert( 1, std::move( kept ) );
+    std::cout << lar;
+    std::cout << "copies: " << Tracked::copies << std::endl;
+
+    Lariat<Tracked, 3> other;
+    other = std::move( lar );
+    std::cout << "after move: " << lar.size() << " and " << other.size()
+              << ", copies: " << Tracked::copies << std::endl;
+
+    lar = other; // a real copy
+    std::cout << "after copy: " << lar.size() << ", copies: " << Tracked::copies << std::endl;
+
+    Lariat<Tracked, 3>& same = lar;
+    lar = same;
+    std::cout << "after self-assignment: " << lar.size() << ", copies: " << Tracked::copies
+              << std::endl;
+
+    Lariat<int, 4> merging;
+    merging.merge_underfull( true );
+    Lariat<int, 4> assigned;
+    assigned = merging;
+    std::cout << "merge_underfull copied: " << assigned.merge_underfull() << std::endl;
+}
+
+// has no default constructor, and counts how many are alive
+struct Counted
+{
+    static int live;
+    int value;
+
+    Counted( int v ) : value( v ) { ++live; }
+    Counted( const Counted& rhs ) : value( rhs.value ) { ++live; }
+    ~Counted() { --live; }
+    Counted& operator=( const Counted& rhs ) { value = rhs.value; return *this; }
+};
+int Counted::live = 0;
+
+std::ostream& operator<<( std::ostream& os, const Counted& c )
+{
+    return os << c.value;
+}
+
+void test29() // only the items in use are constructed
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    {
+        Lariat<Counted, 64> lar;
+        for ( int i = 0; i < 3; ++i ) {
+            lar.push_back( Counted( i ) );
+        }
+        std::cout << "size " << lar.size() << ", live: " << Counted::live << std::endl;
+
+        Lariat<Counted, 4> small;
+        for ( int i = 0; i < 10; ++i ) {
+            small.insert( i / 2, Counted( i ) );
+        }
+        small.erase( 3 );
+        small.pop_front();
+        small.pop_back();
+        small.compact();
+        std::cout << small;
+        std::cout << "size " << lar.size() + small.size() << ", live: " << Counted::live << std::endl;
+    }
+    std::cout << "live after destruction: " << Counted::live << std::endl;
+}
+
+// counts what it hands out and gets back
+int allocated = 0;
+int deallocated = 0;
+
+template <typename T>
+struct CountingAllocator
+{
+    typedef T value_type;
+
+    CountingAllocator() {}
+    template <typename U> CountingAllocator( const CountingAllocator<U>& ) {}
+
+    T* allocate( size_t n ) { ++allocated; return std::allocator<T>().allocate( n ); }
+    void deallocate( T* p, size_t n ) { ++deallocated; std::allocator<T>().deallocate( p, n ); }
+};
+template <typename T, typename U>
+bool operator==( const CountingAllocator<T>&, const CountingAllocator<U>& ) { return true; }
+template <typename T, typename U>
+bool operator!=( const CountingAllocator<T>&, const CountingAllocator<U>& ) { return false; }
+
+void test30() // node pool and allocator
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    {
+        Lariat<int, 4, CountingAllocator<int> > lar;
+        for ( int i = 0; i < 1000; ++i ) {
+            lar.insert( i / 3, i );
+        }
+        std::cout << "size " << lar.size() << ", allocations: " << allocated << std::endl;
+
+        // the nodes freed are used again
+        int before = allocated;
+        for ( int i = 0; i < 20; ++i ) {
+            lar.clear();
+            for ( int j = 0; j < 1000; ++j ) {
+                lar.push_front( j );
+            }
+        }
+        std::cout << "allocations refilling: " << allocated - before << std::endl;
+
+        lar.clear();
+        lar.shrink_to_fit();
+        std::cout << "deallocations after shrink: " << deallocated << std::endl;
+
+        lar.push_back( 7 );
+        Lariat<int, 4, CountingAllocator<int> > copy( lar );
+        std::cout << copy;
+    }
+    std::cout << "allocated " << allocated << ", deallocated " << deallocated << std::endl;
+}
+
+void test31() // range insert and splice
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    const int asize = 4;
+    Lariat<int, asize> lar;
+    for ( int i = 0; i < 6; ++i ) {
+        lar.push_back( i );
+    }
+
+    std::vector<int> batch;
+    for ( int i = 100; i < 110; ++i ) {
+        batch.push_back( i );
+    }
+    lar.insert( 2, batch.begin(), batch.end() );
+    std::cout << lar;
+
+    Lariat<int, asize> other;
+    for ( int i = 0; i < 9; ++i ) {
+        other.push_back( -i );
+    }
+    lar.splice( 1, other, 3, 8 );
+    std::cout << lar;
+    std::cout << other;
+
+    lar.splice( static_cast<int>( lar.size() ), other );
+    std::cout << "sizes " << lar.size() << " and " << other.size() << std::endl;
+}
+
+bool is_odd( int i ) { return i % 2 != 0; }
+
+void test32() // find, count and min/max scans
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 40> ids;
+    for ( int i = 0; i < 1000; ++i ) {
+        ids.push_back( ( i * 37 ) % 101 - 50 );
+    }
+    std::cout << "find 17: " << ids.find( 17 ) << ", find 99: " << ids.find( 99 ) << std::endl;
+    std::cout << "count 17: " << ids.count( 17 ) << ", count odd: " << ids.count_if( is_odd ) << std::endl;
+    std::cout << "first over 45: " << ids.find_if( std::bind( std::greater<int>(), std::placeholders::_1, 45 ) ) << std::endl;
+    std::pair<int, int> range = ids.min_max();
+    std::cout << "min " << range.first << ", max " << range.second << std::endl;
+
+    Lariat<unsigned, 16> big;
+    for ( unsigned i = 0; i < 100; ++i ) {
+        big.push_front( i * 0x3000000u );
+    }
+    std::pair<unsigned, unsigned> big_range = big.min_max();
+    std::cout << "unsigned min " << big_range.first << ", max " << big_range.second << std::endl;
+
+    Lariat<float, 32> readings;
+    for ( int i = 0; i < 200; ++i ) {
+        readings.push_back( static_cast<float>( i % 23 ) * 0.5f - 3.0f );
+    }
+    std::pair<float, float> float_range = readings.min_max();
+    std::cout << "count 2.5: " << readings.count( 2.5f ) << ", min " << float_range.first
+              << ", max " << float_range.second << std::endl;
+
+    Lariat<std::string, 4> words;
+    words.push_back( "pear" );
+    words.push_back( "apple" );
+    words.push_back( "fig" );
+    words.push_back( "apple" );
+    words.push_back( "plum" );
+    std::pair<std::string, std::string> word_range = words.min_max();
+    std::cout << "apples: " << words.count( "apple" ) << ", fig at " << words.find( "fig" )
+              << ", " << word_range.first << " to " << word_range.second << std::endl;
+
+    try {
+        Lariat<int, 4>().min_max();
+    } catch ( const LariatException& e ) {
+        std::cout << "empty: " << e.what() << std::endl;
+    }
+}
+
+void test33() // counted B-tree (rope) index
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    LariatRope<int, 4> rope;
+    for ( int i = 0; i < 5000; ++i ) {
+        rope.insert( static_cast<int>( rope.size() / 2 ), i );
+    }
+    std::cout << "size " << rope.size() << ", first " << rope.first() << ", middle "
+              << rope[2500] << ", last " << rope.last() << std::endl;
+
+    for ( int i = 0; i < 4000; ++i ) {
+        rope.erase( ( i * 7 ) % static_cast<int>( rope.size() ) );
+    }
+    long long sum = 0;
+    for ( LariatRope<int, 4>::iterator it = rope.begin(); it != rope.end(); ++it ) {
+        sum += *it;
+    }
+    std::cout << "size " << rope.size() << ", sum " << sum << ", at 500 " << rope[500] << std::endl;
+
+    LariatRope<int, 4> other;
+    for ( int i = 0; i < 100; ++i ) {
+        other.push_back( -i );
+    }
+    rope.splice( 10, other, 20, 60 );
+    rope.compact();
+    std::cout << "spliced " << rope.size() << " and " << other.size() << ", at 10 " << rope[10]
+              << ", at 49 " << rope[49] << ", at 50 " << rope[50] << std::endl;
+
+    Lariat<int, 8> plain( rope );
+    std::cout << "copied " << plain.size() << ", at 700 " << plain[700] << " " << rope[700] << std::endl;
+
+    try {
+        rope[static_cast<int>( rope.size() )];
+    } catch ( const LariatException& e ) {
+        std::cout << "past the end: " << e.what() << std::endl;
+    }
+
+    const Lariat<int, 4> empty;
+    try {
+        empty[0];
+    } catch ( const LariatException& e ) {
+        std::cout << "empty: " << e.what() << std::endl;
+    }
+    try {
+        Lariat<int, 4>().last();
+    } catch ( const LariatException& e ) {
+        std::cout << "empty last: " << e.what() << std::endl;
+    }
+}
+
+void test34() // merging underfull nodes
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 4> lar;
+    lar.merge_underfull( true );
+    for ( int i = 0; i < 16; ++i ) {
+        lar.push_back( i );
+    }
+    lar.erase( 5 );
+    lar.erase( 5 );
+    lar.erase( 8 );
+    lar.pop_front();
+    lar.pop_front();
+    lar.pop_front();
+    std::cout << lar;
+    std::cout << "fill " << lar.fill_ratio() << std::endl;
+
+    LariatRope<int, 8> kept;
+    LariatRope<int, 8> merged;
+    merged.merge_underfull( true );
+    for ( int i = 0; i < 4000; ++i ) {
+        kept.push_back( i );
+        merged.push_back( i );
+    }
+    for ( int i = 0; i < 3000; ++i ) {
+        int index = ( i * 13 ) % static_cast<int>( kept.size() );
+        kept.erase( index );
+        merged.erase( index );
+    }
+    bool same = true;
+    for ( int i = 0; i < static_cast<int>( kept.size() ); ++i ) {
+        same = same && kept[i] == merged[i];
+    }
+    std::cout << "same items: " << same << ", fill " << kept.fill_ratio() << " without merging, "
+              << merged.fill_ratio() << " with" << std::endl;
+    kept.compact();
+    std::cout << "fill " << kept.fill_ratio() << " after compact, empty "
+              << Lariat<int, 4>().fill_ratio() << std::endl;
+}
+
+void test35() // copy-on-write snapshots
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 4> lar;
+    for ( int i = 0; i < 10; ++i ) {
+        lar.push_back( i );
+    }
+
+    Lariat<int, 4>::snapshot_type before = lar.snapshot();
+    lar[2] = 20;
+    lar.erase( 5 );
+    lar.insert( 0, -1 );
+    lar.push_back( 10 );
+
+    std::cout << "lariat:";
+    for ( Lariat<int, 4>::const_iterator it = lar.cbegin(); it != lar.cend(); ++it ) {
+        std::cout << " " << *it;
+    }
+    std::cout << "\nsnapshot:";
+    for ( Lariat<int, 4>::snapshot_type::const_iterator it = before.begin(); it != before.end(); ++it ) {
+        std::cout << " " << *it;
+    }
+    std::cout << "\nsnapshot size " << before.size() << ", at 5 " << before[5] << ", find 7 at "
+              << before.find( 7 ) << ", count 20 " << before.count( 20 ) << std::endl;
+
+    Lariat<int, 4>::snapshot_type copy( before );
+    LariatRope<std::string, 2> words;
+    words.push_back( "alpha" );
+    words.push_back( "beta" );
+    words.push_back( "gamma" );
+    LariatRope<std::string, 2>::snapshot_type view = words.snapshot();
+    for ( LariatRope<std::string, 2>::iterator it = words.begin(); it != words.end(); ++it ) {
+        *it += "!";
+    }
+    words.clear();
+    std::cout << "words " << words.size() << ", view " << view[0] << " " << view[1] << " " << view[2]
+              << ", copy at 9 " << copy[9] << std::endl;
+
+    try {
+        view[3];
+    } catch ( const LariatException& e ) {
+        std::cout << "past the end: " << e.what() << std::endl;
+    }
+}
 
-void (*pTests[])(void) = {/*test0,  test1,  test2,  test3,  test4,  test5,  test6,  test7,  test8,
+void (*pTests[])(void) = {test0,  test1,  test2,  test3,  test4,  test5,  test6,  test7,  test8,
                           test9,  test10, test11, test12, test13, test14, test15, test16, test17,
-                          test18, test19, test20, test21, test22, test23,*/ test24, /*test25, test26*/};
+                          test18, test19, test20, test21, test22, test23, test24, test25, test26,
+                          test27, test28, test29, test30, test31, test32, test33, test34, test35};
 
 void test_all() {
 	for (size_t i = 0; i<sizeof(pTests)/sizeof(pTests[0]); ++i)
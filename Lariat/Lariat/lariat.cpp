@@ -2,10 +2,10 @@
 #include <iomanip>
 
 #if 1
-template <typename T, int Size>
-std::ostream& operator<<(std::ostream& os, Lariat<T, Size> const& list)
+template <typename T, int Size, typename Allocator, template <typename> class Index>
+std::ostream& operator<<(std::ostream& os, Lariat<T, Size, Allocator, Index> const& list)
 {
-	typename Lariat<T, Size>::LNode* current = list.head_;
+	typename Lariat<T, Size, Allocator, Index>::LNode* current = list.head_;
 	int index = 0;
 	while (current)
 	{
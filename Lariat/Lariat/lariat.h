@@ -11,9 +11,22 @@
 #define LARIAT_H
 ////////////////////////////////////////////////////////////////////////////////
 
-#include <cstring> // memcpy
-#include <string>  // error strings
-#include <utility> // error strings
+#include <algorithm>   // min
+#include <atomic>      // node reference counts
+#include <cstddef>     // ptrdiff_t
+#include <cstring>     // memcpy
+#include <functional>  // less
+#include <iterator>    // iterator tags
+#include <memory>      // allocator_traits
+#include <new>         // placement new
+#include <string>      // error strings
+#include <type_traits> // is_trivially_copyable
+#include <utility>     // error strings
+#include <vector>      // node index
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h> // SSE2
+#define LARIAT_SSE2
+#endif
 
 class LariatException : public std::exception
 {
@@ -49,417 +62,2869 @@ public:
     };
 };
 
-// forward declaration for 1-1 operator<<
-template <typename T, int Size>
-class Lariat;
+// most nodes a Lariat allocates at once for its node pool
+const int LARIAT_MAX_BLOCK_NODES = 64;
 
-template <typename T, int Size>
-std::ostream& operator<<(std::ostream& os, Lariat<T, Size> const& rhs);
-
-template <typename T, int Size>
-class Lariat
+// lowers min and raises max to take in the values
+template <typename T>
+void LariatMinMax(const T* values, int count, T& min, T& max)
 {
-    template <typename OtherT, int OtherSize>
-    friend class Lariat;
-
-public:
-    Lariat() : head_(nullptr), tail_(nullptr), size_(0), nodecount_(0), asize_(Size)
+    for (int i = 0; i < count; i++)
     {
+        if (values[i] < min)
+        {
+            min = values[i];
+        }
+        if (max < values[i])
+        {
+            max = values[i];
+        }
     }
+}
 
-    Lariat(Lariat<T, Size> const& copy) : Lariat()
+// Searches of the values of one node. int, unsigned and float have SIMD versions below.
+template <typename T>
+struct LariatScan
+{
+    // returns the position of the first value equal to value, count if there's none
+    static int find(const T* values, int count, const T& value)
     {
-        copy_from(copy);
+        for (int i = 0; i < count; i++)
+        {
+            if (values[i] == value)
+            {
+                return i;
+            }
+        }
+        return count;
     }
 
-    template <typename OtherT, int OtherSize>
-    Lariat(Lariat<OtherT, OtherSize> const& copy) : Lariat()
+    // returns how many values are equal to value
+    static int count(const T* values, int count, const T& value)
     {
-        copy_from(copy);
+        int found = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (values[i] == value)
+            {
+                found++;
+            }
+        }
+        return found;
     }
 
-    ~Lariat()
+    static void min_max(const T* values, int count, T& min, T& max)
     {
-        clear();
+        LariatMinMax(values, count, min, max);
     }
+};
+
+#if defined(LARIAT_SSE2)
+// 32-bit integers, 4 to a register and 16 at a time. Bias flips the sign bit of unsigned values,
+// so SSE2's signed compares order them.
+template <typename T, unsigned Bias>
+struct LariatScanInt32
+{
+    static_assert(sizeof(T) == 4, "32-bit integers only");
 
-    Lariat& operator=(Lariat<T, Size> const& rhs)
+    static __m128i load(const T* values)
     {
-        clear();
-        copy_from(rhs);
-        return *this;
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
     }
 
-    template <typename OtherT, int OtherSize>
-    Lariat& operator=(Lariat<OtherT, OtherSize> const& rhs)
+    static int find(const T* values, int count, const T& value)
     {
-        clear();
-        copy_from(rhs);
-        return *this;
+        const __m128i needle = _mm_set1_epi32(static_cast<int>(value));
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i a = _mm_cmpeq_epi32(load(values + i), needle);
+            __m128i b = _mm_cmpeq_epi32(load(values + i + 4), needle);
+            __m128i c = _mm_cmpeq_epi32(load(values + i + 8), needle);
+            __m128i d = _mm_cmpeq_epi32(load(values + i + 12), needle);
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))))
+            {
+                break; // it's in these 16, the loop below finds it
+            }
+        }
+        for (; i < count; i++)
+        {
+            if (values[i] == value)
+            {
+                return i;
+            }
+        }
+        return count;
     }
 
-    // inserts
-    void insert(int index, const T& value)
+    static int count(const T* values, int count, const T& value)
     {
-        // Throw exception for bad index
-        if (index < 0 || index > size_)
+        // A match compares to -1, so subtracting the compares counts them in each lane
+        const __m128i needle = _mm_set1_epi32(static_cast<int>(value));
+        __m128i found = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
         {
-            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+            __m128i a = _mm_cmpeq_epi32(load(values + i), needle);
+            __m128i b = _mm_cmpeq_epi32(load(values + i + 4), needle);
+            __m128i c = _mm_cmpeq_epi32(load(values + i + 8), needle);
+            __m128i d = _mm_cmpeq_epi32(load(values + i + 12), needle);
+            found = _mm_sub_epi32(found, _mm_add_epi32(_mm_add_epi32(a, b), _mm_add_epi32(c, d)));
+        }
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), found);
+        int total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; i < count; i++)
+        {
+            if (values[i] == value)
+            {
+                total++;
+            }
         }
+        return total;
+    }
 
-        // If the list is empty, create a new node and set the head and tail to it
-        if (!head_)
+    static void min_max(const T* values, int count, T& min, T& max)
+    {
+        int i = 0;
+        if (count >= 8)
         {
-            head_ = new LNode;
-            tail_ = head_;
-            nodecount_++;
+            const __m128i bias = _mm_set1_epi32(static_cast<int>(Bias));
+            __m128i low = _mm_xor_si128(load(values), bias);
+            __m128i high = low;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i a = _mm_xor_si128(load(values + i), bias);
+                __m128i b = _mm_xor_si128(load(values + i + 4), bias);
+                low = select_min(low, select_min(a, b));
+                high = select_max(high, select_max(a, b));
+            }
+
+            // Fold the lanes into lane 0
+            low = select_min(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+            low = select_min(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+            high = select_max(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+            high = select_max(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+            T lanes[2] = {
+                static_cast<T>(_mm_cvtsi128_si32(_mm_xor_si128(low, bias))),
+                static_cast<T>(_mm_cvtsi128_si32(_mm_xor_si128(high, bias)))};
+            LariatMinMax(lanes, 2, min, max);
         }
+        LariatMinMax(values + i, count - i, min, max);
+    }
 
-        // Find the node to insert into and the local index within that node
-        std::pair<LNode*, int> position = find_element(index);
-        LNode* current = position.first;
-        int local_index = position.second;
+    // SSE2 has no 32-bit min and max, so they're a compare and a select
+    static __m128i select_min(__m128i a, __m128i b)
+    {
+        __m128i greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+    }
 
-        // Shift all the elements of the node to the right starting at the index
-        shift_up(current, local_index);
+    static __m128i select_max(__m128i a, __m128i b)
+    {
+        __m128i greater = _mm_cmpgt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+    }
+};
 
-        // If the node is full, take the element at the position of the index and move it to a new
-        // node
-        if (current->count == asize_)
-        {
-            int split_index = static_cast<int>(asize_ / 2 + 1);
-            split_node(current, split_index);
+template <>
+struct LariatScan<int> : LariatScanInt32<int, 0u>
+{
+};
+
+template <>
+struct LariatScan<unsigned> : LariatScanInt32<unsigned, 0x80000000u>
+{
+};
 
-            // The insertion index is in the right half, put it in the next node
-            T* overflow = local_index == asize_ ? nullptr : &current->values[local_index];
-            T* overflow_destination = nullptr;
-            if (local_index >= split_index)
+// floats, 4 to a register and 16 at a time. A NaN is never found, and min_max may or may not
+// skip it.
+template <>
+struct LariatScan<float>
+{
+    static int find(const float* values, int count, const float& value)
+    {
+        const __m128 needle = _mm_set1_ps(value);
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128 a = _mm_cmpeq_ps(_mm_loadu_ps(values + i), needle);
+            __m128 b = _mm_cmpeq_ps(_mm_loadu_ps(values + i + 4), needle);
+            __m128 c = _mm_cmpeq_ps(_mm_loadu_ps(values + i + 8), needle);
+            __m128 d = _mm_cmpeq_ps(_mm_loadu_ps(values + i + 12), needle);
+            if (_mm_movemask_ps(_mm_or_ps(_mm_or_ps(a, b), _mm_or_ps(c, d))))
             {
-                local_index -= current->count;
-                current = current->next;
-                overflow_destination = &current->values[current->count];
+                break; // it's in these 16, the loop below finds it
             }
-            else
+        }
+        for (; i < count; i++)
+        {
+            if (values[i] == value)
             {
-                overflow_destination = &current->next->values[current->next->count];
-                current->count--;
-                current->next->count++;
+                return i;
             }
+        }
+        return count;
+    }
 
-            if (overflow != nullptr)
+    static int count(const float* values, int count, const float& value)
+    {
+        const __m128 needle = _mm_set1_ps(value);
+        __m128i found = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128 a = _mm_cmpeq_ps(_mm_loadu_ps(values + i), needle);
+            __m128 b = _mm_cmpeq_ps(_mm_loadu_ps(values + i + 4), needle);
+            __m128 c = _mm_cmpeq_ps(_mm_loadu_ps(values + i + 8), needle);
+            __m128 d = _mm_cmpeq_ps(_mm_loadu_ps(values + i + 12), needle);
+            __m128i matches = _mm_add_epi32(
+                _mm_add_epi32(_mm_castps_si128(a), _mm_castps_si128(b)),
+                _mm_add_epi32(_mm_castps_si128(c), _mm_castps_si128(d)));
+            found = _mm_sub_epi32(found, matches);
+        }
+        int lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), found);
+        int total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; i < count; i++)
+        {
+            if (values[i] == value)
             {
-                std::swap(*overflow, *overflow_destination);
+                total++;
             }
         }
+        return total;
+    }
 
-        // There was room in the node for the inserted value
-        current->values[local_index] = value;
-        current->count++;
-        size_++;
+    static void min_max(const float* values, int count, float& min, float& max)
+    {
+        int i = 0;
+        if (count >= 8)
+        {
+            __m128 low = _mm_loadu_ps(values);
+            __m128 high = low;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128 a = _mm_loadu_ps(values + i);
+                __m128 b = _mm_loadu_ps(values + i + 4);
+                low = _mm_min_ps(low, _mm_min_ps(a, b));
+                high = _mm_max_ps(high, _mm_max_ps(a, b));
+            }
+
+            // Fold the lanes into lane 0
+            low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(1, 0, 3, 2)));
+            low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(2, 3, 0, 1)));
+            high = _mm_max_ps(high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(1, 0, 3, 2)));
+            high = _mm_max_ps(high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(2, 3, 0, 1)));
+            float lanes[2] = {_mm_cvtss_f32(low), _mm_cvtss_f32(high)};
+            LariatMinMax(lanes, 2, min, max);
+        }
+        LariatMinMax(values + i, count - i, min, max);
+    }
+};
+#endif
+
+// most children of a block of LariatRopeIndex
+const int LARIAT_ROPE_FANOUT = 32;
+
+/*
+Counted index over the nodes of a Lariat, so finding the node of an item doesn't walk the list.
+This one keeps the nodes in a vector, with a Fenwick tree of their counts. Finding a node and
+adding or removing a node at either end are O(log nodes): the vector has room in front of the
+first node, so the nodes next to the head move into that instead of the rest moving up. Adding or
+removing a node anywhere else moves every node after it, and the tree is rebuilt (O(nodes)) on
+the next find.
+*/
+template <typename Node>
+class LariatFenwickIndex
+{
+public:
+    LariatFenwickIndex() : first_(0), dirty_(false)
+    {
     }
 
-    void push_back(const T& value)
+    // the number of nodes
+    int size() const
     {
-        insert(size_, value);
+        return static_cast<int>(nodes_.size() - first_);
     }
 
-    void push_front(const T& value)
+    // the node at position
+    Node* node(int position) const
     {
-        insert(0, value);
+        return nodes_[first_ + static_cast<size_t>(position)];
     }
 
-    // deletes
-    void erase(int index)
+    // returns the node holding the item at index (which must be in range), and sets position to
+    // the node's position and index to the item's position within it
+    Node* find(int& index, int& position) const
     {
-        // Throw exception for bad index
-        if (index < 0 || index >= size_)
+        refresh();
+
+        // Descend the Fenwick tree: skip every block of slots that ends at or before index (the
+        // empty slots in front of the first node hold no items, so they're always skipped)
+        int count = slots();
+        int step = 1;
+        while (step * 2 <= count)
         {
-            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+            step *= 2;
+        }
+        int slot = 0;
+        for (; step > 0; step /= 2)
+        {
+            if (slot + step <= count && counts_[slot + step] <= index)
+            {
+                slot += step;
+                index -= counts_[slot];
+            }
         }
+        position = slot - static_cast<int>(first_);
+        return nodes_[static_cast<size_t>(slot)];
+    }
 
-        // If the erase is at the end or beginning, use pop_back or pop_front
-        if (index == size_ - 1)
+    // adds delta to the count of the node at position
+    void add(int position, int delta)
+    {
+        // It will be rebuilt from the counts anyway
+        if (dirty_)
         {
-            pop_back();
             return;
         }
-        else if (index == 0)
+
+        add_slot(static_cast<int>(first_) + position, delta);
+    }
+
+    // puts count nodes at position, holding as many items as they do now
+    void insert(int position, Node* const* nodes, size_t count)
+    {
+        // Growing at the end doesn't move any other node
+        if (position == size() && !dirty_)
         {
-            pop_front();
-            return;
+            for (size_t i = 0; i < count; i++)
+            {
+                nodes_.push_back(nodes[i]);
+                append(nodes[i]->count);
+            }
+        }
+        else if (position <= 1 && count && !dirty_)
+        {
+            // Next to the head, the nodes before position move down into the room in front
+            make_front_room(count);
+            first_ -= count;
+            move_nodes(first_ + count, first_, static_cast<size_t>(position));
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t slot = first_ + static_cast<size_t>(position) + i;
+                nodes_[slot] = nodes[i];
+                add_slot(static_cast<int>(slot), nodes[i]->count);
+            }
+        }
+        else if (count)
+        {
+            nodes_.insert(nodes_.begin() + static_cast<std::ptrdiff_t>(first_) + position, nodes,
+                          nodes + count);
+            dirty_ = true;
         }
+    }
 
-        // Find the node to erase from and the local index within that node
-        std::pair<LNode*, int> position = find_element(index);
-        LNode* current = position.first;
-        int local_index = position.second;
+    // puts node at position in place of the node there, which holds as many items
+    void replace(int position, Node* node)
+    {
+        nodes_[first_ + static_cast<size_t>(position)] = node;
+    }
 
-        // Shift all the elements of the node to the left starting at the index
-        shift_down(current, local_index, 1);
+    // removes count nodes from position on
+    void erase(int position, int count = 1)
+    {
+        size_t slot = first_ + static_cast<size_t>(position);
+        size_t erased = static_cast<size_t>(count);
+        if (position + count == size() || dirty_)
+        {
+            nodes_.erase(nodes_.begin() + static_cast<std::ptrdiff_t>(slot),
+                         nodes_.begin() + static_cast<std::ptrdiff_t>(slot + erased));
 
-        current->count--;
-        size_--;
+            // Dropping the last nodes leaves the rest of the Fenwick tree as it was
+            if (position == size() && !dirty_)
+            {
+                counts_.resize(counts_.size() - erased);
+            }
+            else
+            {
+                dirty_ = true;
+            }
+        }
+        else if (position <= 1)
+        {
+            // Next to the head, the nodes before position move up over the removed ones
+            for (size_t i = slot; i < slot + erased; i++)
+            {
+                add_slot(static_cast<int>(i), -count_at(i));
+            }
+            move_nodes(first_, first_ + erased, static_cast<size_t>(position));
+            std::fill(nodes_.begin() + static_cast<std::ptrdiff_t>(first_),
+                      nodes_.begin() + static_cast<std::ptrdiff_t>(first_ + erased), nullptr);
+            first_ += erased;
+        }
+        else
+        {
+            nodes_.erase(nodes_.begin() + static_cast<std::ptrdiff_t>(slot),
+                         nodes_.begin() + static_cast<std::ptrdiff_t>(slot + erased));
+            dirty_ = true;
+        }
 
-        // If the node is empty after the erase, delete the node and update the pointers
-        if (current->count == 0)
+        if (!size())
         {
-            delete_node(current);
+            clear();
         }
     }
-    void pop_back()
+
+    // the counts of the nodes changed, so rebuild the index on the next find
+    void invalidate()
     {
-        // If the list is empty, do nothing
-        if (!head_)
+        dirty_ = true;
+    }
+
+    // makes room for count more nodes
+    void reserve_more(size_t count)
+    {
+        nodes_.reserve(nodes_.size() + count);
+    }
+
+    void clear()
+    {
+        nodes_.clear();
+        counts_.clear();
+        first_ = 0;
+        dirty_ = false;
+    }
+
+    void swap(LariatFenwickIndex& other) noexcept
+    {
+        nodes_.swap(other.nodes_);
+        counts_.swap(other.counts_);
+        std::swap(first_, other.first_);
+        std::swap(dirty_, other.dirty_);
+    }
+
+private:
+    // the number of slots, the empty ones in front of the first node included
+    int slots() const
+    {
+        return static_cast<int>(nodes_.size());
+    }
+
+    // Rebuilds the Fenwick tree from the node counts, if it's out of date
+    void refresh() const
+    {
+        if (!dirty_)
         {
             return;
         }
 
-        tail_->count--;
-        size_--;
+        int count = slots();
+        counts_.assign(static_cast<size_t>(count) + 1, 0);
+        for (int i = 1; i <= count; i++)
+        {
+            Node* node = nodes_[static_cast<size_t>(i - 1)];
+            counts_[i] += node ? node->count : 0;
+            int parent = i + (i & -i);
+            if (parent <= count)
+            {
+                counts_[parent] += counts_[i];
+            }
+        }
+        dirty_ = false;
+    }
 
-        // If the node is now empty, delete the node and update the pointers
-        if (tail_->count == 0)
+    // Adds delta to the count of the node in slot
+    void add_slot(int slot, int delta)
+    {
+        int count = slots();
+        for (int i = slot + 1; i <= count; i += i & -i)
         {
-            delete_node(tail_);
+            counts_[i] += delta;
         }
     }
-    void pop_front()
+
+    // The count of the node in slot, as the tree has it
+    int count_at(size_t slot) const
     {
-        // If the list is empty, do nothing
-        if (!head_)
+        int i = static_cast<int>(slot) + 1;
+        int count = counts_[i];
+        for (int stop = i - (i & -i), child = i - 1; child > stop; child -= child & -child)
+        {
+            count -= counts_[child];
+        }
+        return count;
+    }
+
+    // Moves count nodes, and their counts in the tree, from slot source on to slot destination on
+    void move_nodes(size_t source, size_t destination, size_t count)
+    {
+        for (size_t k = 0; k < count; k++)
+        {
+            // Going away from the other end, so no node is overwritten before it's moved
+            size_t i = destination < source ? k : count - 1 - k;
+            int moved = count_at(source + i);
+            add_slot(static_cast<int>(source + i), -moved);
+            add_slot(static_cast<int>(destination + i), moved);
+            nodes_[destination + i] = nodes_[source + i];
+        }
+    }
+
+    // Makes sure there are at least count empty slots in front of the first node, adding as many
+    // as there are nodes if there aren't, so pushing at the front is amortized O(1)
+    void make_front_room(size_t count)
+    {
+        if (first_ >= count)
         {
             return;
         }
 
-        // Shift all the elements of the node to the left
-        shift_down(head_, 0, 1);
+        size_t room = std::max(count, nodes_.size() - first_);
+        nodes_.insert(nodes_.begin(), room, nullptr);
+        first_ += room;
+        dirty_ = true;
+        refresh();
+    }
 
-        head_->count--;
-        size_--;
+    // Adds the node just pushed on the back of nodes_, which holds count items, to the tree
+    void append(int count)
+    {
+        // The new entry also sums the entries below it that its block covers
+        int i = slots();
+        int stop = i - (i & -i);
+        for (int child = i - 1; child > stop; child -= child & -child)
+        {
+            count += counts_[child];
+        }
+        if (counts_.empty())
+        {
+            counts_.push_back(0);
+        }
+        counts_.push_back(count);
+    }
 
-        // If the node is now empty, delete the node and update the pointers
-        if (head_->count == 0)
+    std::vector<Node*> nodes_;        // the nodes, in list order, after first_ empty slots
+    mutable std::vector<int> counts_; // Fenwick tree of the slot counts (1-based)
+    size_t first_;                    // the slot of the first node
+    mutable bool dirty_;              // counts_ needs rebuilding from nodes_
+};
+
+/*
+Counted index over the nodes of a Lariat, as a B-tree of subtree counts (a rope) with the nodes
+as its leaves. Finding a node, and adding or removing one anywhere, are all O(log nodes), so it's
+the one for lariats of millions of items that change in the middle. A block that falls under half
+full is merged with a neighbour when they fit in one, which keeps the tree shallow.
+*/
+template <typename Node>
+class LariatRopeIndex
+{
+public:
+    LariatRopeIndex() : root_(nullptr), height_(0), size_(0), dirty_(false)
+    {
+    }
+
+    LariatRopeIndex(LariatRopeIndex const&) = delete;
+    LariatRopeIndex& operator=(LariatRopeIndex const&) = delete;
+
+    ~LariatRopeIndex()
+    {
+        clear();
+    }
+
+    // the number of nodes
+    int size() const
+    {
+        return size_;
+    }
+
+    // the node at position
+    Node* node(int position) const
+    {
+        Block* block = root_;
+        int nodes = size_;
+        for (int level = height_; level > 1; level--)
         {
-            delete_node(head_);
+            int i = child_at(block, nodes, position);
+            nodes = block->nodes[i];
+            block = block->children[i].block;
         }
+        return block->children[position].node;
     }
 
-    // access
-    T& operator[](int index) // for l-values
+    // returns the node holding the item at index (which must be in range), and sets position to
+    // the node's position and index to the item's position within it
+    Node* find(int& index, int& position) const
     {
-        std::pair<LNode*, int> element = find_element(index);
-        return element.first->values[element.second];
+        refresh();
+
+        position = 0;
+        Block* block = root_;
+        for (int level = height_;; level--)
+        {
+            int i = 0;
+            while (index >= block->items[i])
+            {
+                index -= block->items[i];
+                position += block->nodes[i];
+                i++;
+            }
+            if (level == 1)
+            {
+                return block->children[i].node;
+            }
+            block = block->children[i].block;
+        }
     }
-    const T& operator[](int index) const // for r-values
+
+    // adds delta to the count of the node at position
+    void add(int position, int delta)
     {
-        std::pair<LNode*, int> element = find_element(index);
-        return element.first->values[element.second];
+        // It will be recounted anyway
+        if (dirty_)
+        {
+            return;
+        }
+
+        Block* block = root_;
+        int nodes = size_;
+        for (int level = height_;; level--)
+        {
+            int i = child_at(block, nodes, position);
+            nodes = block->nodes[i];
+            block->items[i] += delta;
+            if (level == 1)
+            {
+                return;
+            }
+            block = block->children[i].block;
+        }
+    }
+
+    // puts count nodes at position, holding as many items as they do now
+    void insert(int position, Node* const* nodes, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            insert(position + static_cast<int>(i), nodes[i]);
+        }
+    }
+
+    // puts node at position in place of the node there, which holds as many items
+    void replace(int position, Node* node)
+    {
+        Block* block = root_;
+        int nodes = size_;
+        for (int level = height_; level > 1; level--)
+        {
+            int i = child_at(block, nodes, position);
+            nodes = block->nodes[i];
+            block = block->children[i].block;
+        }
+        block->children[position].node = node;
+    }
+
+    // removes count nodes from position on
+    void erase(int position, int count = 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            erase_from(root_, height_, size_, position);
+            size_--;
+
+            // A root with one child is a level too many
+            while (height_ > 1 && root_->count == 1)
+            {
+                Block* child = root_->children[0].block;
+                delete root_;
+                root_ = child;
+                height_--;
+            }
+            if (root_->count == 0)
+            {
+                delete root_;
+                root_ = nullptr;
+                height_ = 0;
+            }
+        }
+    }
+
+    // the counts of the nodes changed, so recount the index on the next find
+    void invalidate()
+    {
+        dirty_ = true;
+    }
+
+    void reserve_more(size_t)
+    {
+    }
+
+    void clear()
+    {
+        free_blocks(root_, height_);
+        root_ = nullptr;
+        height_ = 0;
+        size_ = 0;
+        dirty_ = false;
+    }
+
+    void swap(LariatRopeIndex& other) noexcept
+    {
+        std::swap(root_, other.root_);
+        std::swap(height_, other.height_);
+        std::swap(size_, other.size_);
+        std::swap(dirty_, other.dirty_);
+    }
+
+private:
+    struct Block;
+
+    union Child
+    {
+        Block* block; // in the blocks above the bottom level
+        Node* node;   // in the blocks of the bottom level
+    };
+
+    struct Block
+    {
+        int count;                              // children in use
+        int items[LARIAT_ROPE_FANOUT];          // items under each child
+        int nodes[LARIAT_ROPE_FANOUT];          // nodes under each child (1 on the bottom level)
+        Child children[LARIAT_ROPE_FANOUT];
+    };
+
+    // Returns the child of block (which has nodes nodes under it) that the node at position is
+    // under, and makes position relative to that child. Counts from the nearer end, so the last
+    // node, where most of the changes happen, is as quick to get to as the first.
+    static int child_at(Block* block, int nodes, int& position)
+    {
+        int i = 0;
+        if (position < nodes / 2)
+        {
+            while (position >= block->nodes[i])
+            {
+                position -= block->nodes[i];
+                i++;
+            }
+        }
+        else
+        {
+            i = block->count - 1;
+            int start = nodes - block->nodes[i];
+            while (position < start)
+            {
+                i--;
+                start -= block->nodes[i];
+            }
+            position -= start;
+        }
+        return i;
+    }
+
+    // Puts node at position
+    void insert(int position, Node* node)
+    {
+        if (!root_)
+        {
+            root_ = new Block();
+            height_ = 1;
+        }
+
+        Child child;
+        child.node = node;
+        Block* sibling = insert_into(root_, height_, position, child, node->count, 1);
+        if (sibling)
+        {
+            // The root was split, the tree grows a level
+            Block* root = new Block();
+            child.block = root_;
+            place(root, 0, child);
+            child.block = sibling;
+            place(root, 1, child);
+            root_ = root;
+            height_++;
+        }
+        size_++;
+    }
+
+    // Puts child, which has items items and nodes nodes, at position under block. Returns the
+    // block that block was split into to make room, if it was.
+    Block* insert_into(Block* block, int level, int position, Child child, int items, int nodes)
+    {
+        if (level == 1)
+        {
+            return place_split(block, position, child, items, nodes);
+        }
+
+        // The child the position falls in (the end of one counts as in it)
+        int i = 0;
+        while (i < block->count - 1 && position > block->nodes[i])
+        {
+            position -= block->nodes[i];
+            i++;
+        }
+
+        Block* split = insert_into(block->children[i].block, level - 1, position, child, items, nodes);
+        if (!split)
+        {
+            block->items[i] += items;
+            block->nodes[i] += nodes;
+            return nullptr;
+        }
+
+        total(block->children[i].block, block->items[i], block->nodes[i]);
+        Child split_child;
+        split_child.block = split;
+        int split_items = 0;
+        int split_nodes = 0;
+        total(split, split_items, split_nodes);
+        return place_split(block, i + 1, split_child, split_items, split_nodes);
+    }
+
+    // Puts child at position in block, splitting block in two first if it's full. Returns the new
+    // right half if it was split.
+    Block* place_split(Block* block, int position, Child child, int items, int nodes)
+    {
+        Block* sibling = nullptr;
+        Block* target = block;
+        if (block->count == LARIAT_ROPE_FANOUT)
+        {
+            sibling = new Block();
+            int half = block->count / 2;
+            move_children(sibling, 0, block, half, block->count - half);
+            sibling->count = block->count - half;
+            block->count = half;
+            if (position > half)
+            {
+                position -= half;
+                target = sibling;
+            }
+        }
+        place(target, position, child, items, nodes);
+        return sibling;
+    }
+
+    // Puts child (a block) at position in block, counting what's under it
+    void place(Block* block, int position, Child child)
+    {
+        int items = 0;
+        int nodes = 0;
+        total(child.block, items, nodes);
+        place(block, position, child, items, nodes);
+    }
+
+    void place(Block* block, int position, Child child, int items, int nodes)
+    {
+        move_children(block, position + 1, block, position, block->count - position);
+        block->items[position] = items;
+        block->nodes[position] = nodes;
+        block->children[position] = child;
+        block->count++;
+    }
+
+    // Removes the child at position from block
+    void remove(Block* block, int position)
+    {
+        move_children(block, position, block, position + 1, block->count - position - 1);
+        block->count--;
+    }
+
+    // Copies count children of source, from source_position on, to destination_position on in
+    // destination (which can be the same block)
+    static void move_children(
+        Block* destination, int destination_position, Block* source, int source_position,
+        int count)
+    {
+        size_t length = static_cast<size_t>(count);
+        std::memmove(
+            destination->items + destination_position, source->items + source_position,
+            length * sizeof(int));
+        std::memmove(
+            destination->nodes + destination_position, source->nodes + source_position,
+            length * sizeof(int));
+        std::memmove(
+            destination->children + destination_position, source->children + source_position,
+            length * sizeof(Child));
+    }
+
+    // Removes the node at position under block, which has nodes nodes under it. Returns the
+    // items it was counted with.
+    int erase_from(Block* block, int level, int nodes, int position)
+    {
+        if (level == 1)
+        {
+            int items = block->items[position];
+            remove(block, position);
+            return items;
+        }
+
+        int i = child_at(block, nodes, position);
+        Block* child = block->children[i].block;
+        int items = erase_from(child, level - 1, block->nodes[i], position);
+        block->items[i] -= items;
+        block->nodes[i]--;
+        if (child->count == 0)
+        {
+            delete child;
+            remove(block, i);
+        }
+        else if (child->count < LARIAT_ROPE_FANOUT / 2)
+        {
+            merge(block, i);
+        }
+        return items;
+    }
+
+    // Merges the child at position in block with a neighbour, if they fit in one
+    void merge(Block* block, int position)
+    {
+        int left = position;
+        if (position + 1 < block->count &&
+            block->children[position].block->count +
+                    block->children[position + 1].block->count <=
+                LARIAT_ROPE_FANOUT)
+        {
+            left = position;
+        }
+        else if (
+            position > 0 && block->children[position - 1].block->count +
+                                    block->children[position].block->count <=
+                                LARIAT_ROPE_FANOUT)
+        {
+            left = position - 1;
+        }
+        else
+        {
+            return;
+        }
+
+        Block* into = block->children[left].block;
+        Block* from = block->children[left + 1].block;
+        move_children(into, into->count, from, 0, from->count);
+        into->count += from->count;
+        block->items[left] += block->items[left + 1];
+        block->nodes[left] += block->nodes[left + 1];
+        delete from;
+        remove(block, left + 1);
+    }
+
+    // Sums the items and nodes under block
+    static void total(Block* block, int& items, int& nodes)
+    {
+        items = 0;
+        nodes = 0;
+        for (int i = 0; i < block->count; i++)
+        {
+            items += block->items[i];
+            nodes += block->nodes[i];
+        }
+    }
+
+    // Recounts the items from the nodes, if the counts are out of date
+    void refresh() const
+    {
+        if (dirty_)
+        {
+            recount(root_, height_);
+            dirty_ = false;
+        }
+    }
+
+    static void recount(Block* block, int level)
+    {
+        for (int i = 0; block && i < block->count; i++)
+        {
+            if (level == 1)
+            {
+                block->items[i] = block->children[i].node->count;
+            }
+            else
+            {
+                recount(block->children[i].block, level - 1);
+                total(block->children[i].block, block->items[i], block->nodes[i]);
+            }
+        }
+    }
+
+    static void free_blocks(Block* block, int level)
+    {
+        for (int i = 0; block && level > 1 && i < block->count; i++)
+        {
+            free_blocks(block->children[i].block, level - 1);
+        }
+        delete block;
+    }
+
+    Block* root_;        // the top of the tree
+    int height_;         // levels of blocks (0 when there are no nodes)
+    int size_;           // the number of nodes
+    mutable bool dirty_; // the items need recounting from the nodes
+};
+
+// nodes a LariatAdaptiveIndex holds before a change in the middle moves it to a rope
+const int LARIAT_ROPE_THRESHOLD = 1024;
+
+/*
+Counted index over the nodes of a Lariat that starts as a LariatFenwickIndex and moves its nodes
+to a LariatRopeIndex the first time a node is added or removed in the middle of
+LARIAT_ROPE_THRESHOLD nodes or more. So lists that only grow or shrink at the ends keep the
+Fenwick tree's quicker pushes, and long ones that change in the middle stop paying its O(nodes)
+rebuilds. It goes back to a Fenwick tree when it's emptied.
+*/
+template <typename Node>
+class LariatAdaptiveIndex
+{
+public:
+    LariatAdaptiveIndex() : rope_(false)
+    {
+    }
+
+    // the number of nodes
+    int size() const
+    {
+        return rope_ ? rope_index_.size() : fenwick_.size();
+    }
+
+    // the node at position
+    Node* node(int position) const
+    {
+        return rope_ ? rope_index_.node(position) : fenwick_.node(position);
+    }
+
+    // returns the node holding the item at index (which must be in range), and sets position to
+    // the node's position and index to the item's position within it
+    Node* find(int& index, int& position) const
+    {
+        return rope_ ? rope_index_.find(index, position) : fenwick_.find(index, position);
+    }
+
+    // adds delta to the count of the node at position
+    void add(int position, int delta)
+    {
+        if (rope_)
+        {
+            rope_index_.add(position, delta);
+        }
+        else
+        {
+            fenwick_.add(position, delta);
+        }
+    }
+
+    // puts count nodes at position, holding as many items as they do now
+    void insert(int position, Node* const* nodes, size_t count)
+    {
+        if (!rope_ && position > 1 && position < size())
+        {
+            to_rope();
+        }
+
+        if (rope_)
+        {
+            rope_index_.insert(position, nodes, count);
+        }
+        else
+        {
+            fenwick_.insert(position, nodes, count);
+        }
+    }
+
+    // puts node at position in place of the node there, which holds as many items
+    void replace(int position, Node* node)
+    {
+        if (rope_)
+        {
+            rope_index_.replace(position, node);
+        }
+        else
+        {
+            fenwick_.replace(position, node);
+        }
+    }
+
+    // removes count nodes from position on
+    void erase(int position, int count = 1)
+    {
+        if (!rope_ && position > 1 && position + count < size())
+        {
+            to_rope();
+        }
+
+        if (!rope_)
+        {
+            fenwick_.erase(position, count);
+        }
+        else
+        {
+            rope_index_.erase(position, count);
+            if (!rope_index_.size())
+            {
+                rope_ = false;
+            }
+        }
+    }
+
+    // the counts of the nodes changed, so recount the index on the next find
+    void invalidate()
+    {
+        if (rope_)
+        {
+            rope_index_.invalidate();
+        }
+        else
+        {
+            fenwick_.invalidate();
+        }
+    }
+
+    // makes room for count more nodes
+    void reserve_more(size_t count)
+    {
+        if (!rope_)
+        {
+            fenwick_.reserve_more(count);
+        }
+    }
+
+    void clear()
+    {
+        fenwick_.clear();
+        rope_index_.clear();
+        rope_ = false;
+    }
+
+    void swap(LariatAdaptiveIndex& other) noexcept
+    {
+        fenwick_.swap(other.fenwick_);
+        rope_index_.swap(other.rope_index_);
+        std::swap(rope_, other.rope_);
+    }
+
+private:
+    // Moves the nodes to the rope if there are enough of them for it to pay off
+    void to_rope()
+    {
+        int count = fenwick_.size();
+        if (count < LARIAT_ROPE_THRESHOLD)
+        {
+            return;
+        }
+
+        std::vector<Node*> nodes(static_cast<size_t>(count));
+        for (int i = 0; i < count; i++)
+        {
+            nodes[static_cast<size_t>(i)] = fenwick_.node(i);
+        }
+        rope_index_.insert(0, nodes.data(), nodes.size());
+
+        // The Fenwick tree may be behind the node counts, or the nodes ahead of it with a change
+        // that's yet to be added, so the rope counts them again on the next find instead
+        rope_index_.invalidate();
+        fenwick_.clear();
+        rope_ = true;
+    }
+
+    LariatFenwickIndex<Node> fenwick_; // the index until it moves to the rope
+    LariatRopeIndex<Node> rope_index_; // the index after it does
+    bool rope_;                        // the nodes are in rope_index_
+};
+
+// forward declaration for 1-1 operator<<
+template <
+    typename T,
+    int Size,
+    typename Allocator = std::allocator<T>,
+    template <typename> class Index = LariatAdaptiveIndex>
+class Lariat;
+
+template <typename T, int Size, typename Allocator, template <typename> class Index>
+std::ostream& operator<<(std::ostream& os, Lariat<T, Size, Allocator, Index> const& rhs);
+
+// A Lariat indexed by a counted B-tree from the start, for lists that are known to grow large and
+// change in the middle
+template <typename T, int Size, typename Allocator = std::allocator<T>>
+using LariatRope = Lariat<T, Size, Allocator, LariatRopeIndex>;
+
+// Nodes are allocated with Allocator (rebound to the node type), a block of them at a time. Nodes
+// that are freed go back to a pool and are reused before a new block is allocated, so the nodes of
+// a lariat tend to sit next to each other in memory. Index finds the node an item is in; it's
+// LariatAdaptiveIndex by default, or LariatFenwickIndex or LariatRopeIndex. A LariatFenwickIndex
+// is O(log nodes) only for finds and for adding or removing nodes at the ends; anywhere else the
+// next find rebuilds it in O(nodes). The default one starts as that and moves to a rope, which is
+// O(log nodes) everywhere, once a list of LARIAT_ROPE_THRESHOLD nodes or more changes in the
+// middle.
+template <typename T, int Size, typename Allocator, template <typename> class Index>
+class Lariat
+{
+    template <
+        typename OtherT,
+        int OtherSize,
+        typename OtherAllocator,
+        template <typename> class OtherIndex>
+    friend class Lariat;
+
+    struct LNode;     // defined below
+    struct node_pool; // defined below
+
+    /**
+     * @brief Random-access iterator over the items. It holds a cursor of a node and an index
+     * within it, so stepping is O(1) and crosses nodes with next and prev, and the item's index in
+     * the lariat, so distances and comparisons are O(1). Jumps out of the node go through the
+     * counted index in O(log nodes). end() is one past the last item of the tail.
+     */
+    template <typename Value, typename Node>
+    class iterator_base
+    {
+        template <typename OtherValue, typename OtherNode>
+        friend class iterator_base;
+        friend class Lariat;
+
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value* pointer;
+        typedef Value& reference;
+
+        iterator_base() : list_(nullptr), node_(nullptr), local_(0), position_(0)
+        {
+        }
+
+        // an iterator converts to a const_iterator
+        template <typename OtherValue, typename OtherNode>
+        iterator_base(iterator_base<OtherValue, OtherNode> const& other)
+            : list_(other.list_), node_(other.node_), local_(other.local_),
+              position_(other.position_)
+        {
+        }
+
+        reference operator*() const
+        {
+            return node_->values[local_];
+        }
+        pointer operator->() const
+        {
+            return &node_->values[local_];
+        }
+        reference operator[](difference_type n) const
+        {
+            return *(*this + n);
+        }
+
+        iterator_base& operator++()
+        {
+            // Stay on the tail at one past its last item, which is end()
+            ++position_;
+            if (++local_ == node_->count && node_->next)
+            {
+                node_ = node_->next;
+                local_ = 0;
+            }
+            return *this;
+        }
+        iterator_base operator++(int)
+        {
+            iterator_base old = *this;
+            ++*this;
+            return old;
+        }
+        iterator_base& operator--()
+        {
+            if (local_ == 0)
+            {
+                node_ = node_->prev;
+                local_ = node_->count;
+            }
+            --local_;
+            --position_;
+            return *this;
+        }
+        iterator_base operator--(int)
+        {
+            iterator_base old = *this;
+            --*this;
+            return old;
+        }
+
+        iterator_base& operator+=(difference_type n)
+        {
+            if (n == 0)
+            {
+                return *this;
+            }
+
+            // Stay in this node if the target is in it (or is end()), otherwise ask the index
+            position_ += static_cast<int>(n);
+            difference_type target = n + local_;
+            if (target >= 0 && (target < node_->count || (target == node_->count && !node_->next)))
+            {
+                local_ = static_cast<int>(target);
+            }
+            else
+            {
+                std::pair<LNode*, int> element = list_->find_element(position_);
+                node_ = element.first;
+                local_ = element.second;
+            }
+            return *this;
+        }
+        iterator_base& operator-=(difference_type n)
+        {
+            return *this += -n;
+        }
+        iterator_base operator+(difference_type n) const
+        {
+            iterator_base result = *this;
+            return result += n;
+        }
+        friend iterator_base operator+(difference_type n, iterator_base const& it)
+        {
+            return it + n;
+        }
+        iterator_base operator-(difference_type n) const
+        {
+            iterator_base result = *this;
+            return result -= n;
+        }
+
+        // the number of items from rhs to this
+        template <typename OtherValue, typename OtherNode>
+        difference_type operator-(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return static_cast<difference_type>(position_) - rhs.position_;
+        }
+
+        template <typename OtherValue, typename OtherNode>
+        bool operator==(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return position_ == rhs.position_;
+        }
+        template <typename OtherValue, typename OtherNode>
+        bool operator!=(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return !(*this == rhs);
+        }
+        template <typename OtherValue, typename OtherNode>
+        bool operator<(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return position_ < rhs.position_;
+        }
+        template <typename OtherValue, typename OtherNode>
+        bool operator>(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return rhs < *this;
+        }
+        template <typename OtherValue, typename OtherNode>
+        bool operator<=(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return !(rhs < *this);
+        }
+        template <typename OtherValue, typename OtherNode>
+        bool operator>=(iterator_base<OtherValue, OtherNode> const& rhs) const
+        {
+            return !(*this < rhs);
+        }
+
+    private:
+        iterator_base(Lariat const* list, Node* node, int local, int position)
+            : list_(list), node_(node), local_(local), position_(position)
+        {
+        }
+
+        Lariat const* list_; // the lariat, whose index finds the node of a far item
+        Node* node_;         // the node of the item
+        int local_;          // the index of the item within the node
+        int position_;       // the index of the item in the lariat
+    };
+
+public:
+    typedef iterator_base<T, LNode> iterator;
+    typedef iterator_base<const T, const LNode> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    /**
+     * Read-only copy of the items of a lariat, as they were when snapshot() took it, that shares
+     * the nodes instead of copying them. The lariat copies a node a snapshot holds before changing
+     * it, so the snapshot never sees a change. Neither side locks: a snapshot can be read, copied
+     * and destroyed on another thread while the lariat keeps changing. The last one holding a
+     * node gives it back to the pool.
+     */
+    class snapshot_type
+    {
+        friend class Lariat;
+
+    public:
+        /**
+         * @brief Forward iterator over the items, a node at a time
+         */
+        class const_iterator
+        {
+            friend class snapshot_type;
+
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const T* pointer;
+            typedef const T& reference;
+
+            const_iterator() : node_(nullptr), local_(0)
+            {
+            }
+
+            reference operator*() const
+            {
+                return (*node_)->values[local_];
+            }
+            pointer operator->() const
+            {
+                return &(*node_)->values[local_];
+            }
+
+            const_iterator& operator++()
+            {
+                if (++local_ == (*node_)->count)
+                {
+                    ++node_;
+                    local_ = 0;
+                }
+                return *this;
+            }
+            const_iterator operator++(int)
+            {
+                const_iterator old = *this;
+                ++*this;
+                return old;
+            }
+
+            bool operator==(const_iterator const& rhs) const
+            {
+                return node_ == rhs.node_ && local_ == rhs.local_;
+            }
+            bool operator!=(const_iterator const& rhs) const
+            {
+                return !(*this == rhs);
+            }
+
+        private:
+            const_iterator(LNode* const* node, int local) : node_(node), local_(local)
+            {
+            }
+
+            LNode* const* node_; // the node of the item, in the snapshot's nodes
+            int local_;          // the index of the item within the node
+        };
+        typedef const_iterator iterator;
+
+        snapshot_type() : size_(0)
+        {
+        }
+
+        snapshot_type(snapshot_type const& copy)
+            : nodes_(copy.nodes_), starts_(copy.starts_), size_(copy.size_), pools_(copy.pools_)
+        {
+            for (size_t i = 0; i < nodes_.size(); i++)
+            {
+                nodes_[i]->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        snapshot_type(snapshot_type&& other) noexcept : size_(0)
+        {
+            swap(other);
+        }
+
+        snapshot_type& operator=(snapshot_type rhs) noexcept
+        {
+            swap(rhs);
+            return *this;
+        }
+
+        ~snapshot_type()
+        {
+            for (size_t i = 0; i < nodes_.size(); i++)
+            {
+                LNode* node = nodes_[i];
+                if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    pools_.front()->give_back(node);
+                }
+            }
+        }
+
+        void swap(snapshot_type& other) noexcept
+        {
+            nodes_.swap(other.nodes_);
+            starts_.swap(other.starts_);
+            std::swap(size_, other.size_);
+            pools_.swap(other.pools_);
+        }
+
+        size_t size() const // total number of items
+        {
+            return static_cast<size_t>(size_);
+        }
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        // a binary search over the nodes
+        const T& operator[](int index) const
+        {
+            if (index < 0 || index >= size_)
+            {
+                throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+            }
+
+            size_t node = static_cast<size_t>(
+                std::upper_bound(starts_.begin(), starts_.end(), index) - starts_.begin() - 1);
+            return nodes_[node]->values[index - starts_[node]];
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(nodes_.data(), 0);
+        }
+        const_iterator end() const
+        {
+            return const_iterator(nodes_.data() + nodes_.size(), 0);
+        }
+
+        // returns index, size (one past last) if not found
+        unsigned find(const T& value) const
+        {
+            for (size_t i = 0; i < nodes_.size(); i++)
+            {
+                int found = LariatScan<T>::find(nodes_[i]->values, nodes_[i]->count, value);
+                if (found < nodes_[i]->count)
+                {
+                    return static_cast<unsigned>(starts_[i] + found);
+                }
+            }
+            return static_cast<unsigned>(size_);
+        }
+
+        // returns how many items are equal to value
+        size_t count(const T& value) const
+        {
+            size_t found = 0;
+            for (size_t i = 0; i < nodes_.size(); i++)
+            {
+                found += static_cast<size_t>(
+                    LariatScan<T>::count(nodes_[i]->values, nodes_[i]->count, value));
+            }
+            return found;
+        }
+
+    private:
+        std::vector<LNode*> nodes_;                      // the nodes, none of them empty
+        std::vector<int> starts_;                        // the index of the first item of each
+        int size_;                                       // the number of items
+        std::vector<std::shared_ptr<node_pool>> pools_; // the pool to give the nodes back to,
+                                                         // then the pools of the spliced nodes
+    };
+
+    Lariat() : Lariat(Allocator())
+    {
+    }
+
+    explicit Lariat(Allocator const& allocator)
+        : head_(nullptr), tail_(nullptr), size_(0), nodecount_(0), asize_(Size),
+          merge_underfull_(false), shared_(false), allocator_(allocator)
+    {
+    }
+
+    Lariat(Lariat const& copy)
+        : Lariat(std::allocator_traits<Allocator>::select_on_container_copy_construction(
+              copy.get_allocator()))
+    {
+        merge_underfull_ = copy.merge_underfull_;
+        copy_from(copy);
+    }
+
+    template <
+        typename OtherT,
+        int OtherSize,
+        typename OtherAllocator,
+        template <typename> class OtherIndex>
+    Lariat(Lariat<OtherT, OtherSize, OtherAllocator, OtherIndex> const& copy) : Lariat()
+    {
+        merge_underfull_ = copy.merge_underfull_;
+        copy_from(copy);
+    }
+
+    // takes the nodes (and the node pool) of other, leaving it empty
+    Lariat(Lariat&& other) noexcept : Lariat(other.get_allocator())
+    {
+        swap_contents(other);
+    }
+
+    ~Lariat()
+    {
+        clear();
+    }
+
+    Lariat& operator=(Lariat const& rhs)
+    {
+        if (this != &rhs)
+        {
+            clear();
+            merge_underfull_ = rhs.merge_underfull_;
+            copy_from(rhs);
+        }
+        return *this;
+    }
+
+    template <
+        typename OtherT,
+        int OtherSize,
+        typename OtherAllocator,
+        template <typename> class OtherIndex>
+    Lariat& operator=(Lariat<OtherT, OtherSize, OtherAllocator, OtherIndex> const& rhs)
+    {
+        clear();
+        merge_underfull_ = rhs.merge_underfull_;
+        copy_from(rhs);
+        return *this;
+    }
+
+    // frees the nodes of this lariat and takes those of rhs, leaving it empty
+    Lariat& operator=(Lariat&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            clear();
+            swap_contents(rhs);
+        }
+        return *this;
+    }
+
+    // inserts (copies the item first, so value may be an item of the lariat)
+    void insert(int index, const T& value)
+    {
+        insert_value(index, T(value));
+    }
+
+    void insert(int index, T&& value)
+    {
+        insert_value(index, std::move(value));
+    }
+
+    // constructs the item first, so args may refer to items of the lariat
+    template <typename... Args>
+    void emplace(int index, Args&&... args)
+    {
+        insert_value(index, T(std::forward<Args>(args)...));
+    }
+
+    void push_back(const T& value)
+    {
+        insert(size_, value);
+    }
+
+    void push_back(T&& value)
+    {
+        insert(size_, std::move(value));
+    }
+
+    void push_front(const T& value)
+    {
+        insert(0, value);
+    }
+
+    void push_front(T&& value)
+    {
+        insert(0, std::move(value));
+    }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        emplace(size_, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void emplace_front(Args&&... args)
+    {
+        emplace(0, std::forward<Args>(args)...);
+    }
+
+    // inserts the items of [first, last) at index: the node there is split once, and the items
+    // fill up the node before the index, then new nodes
+    template <
+        typename InputIt,
+        typename = typename std::iterator_traits<InputIt>::iterator_category>
+    void insert(int index, InputIt first, InputIt last)
+    {
+        // Throw exception for bad index
+        if (index < 0 || index > size_)
+        {
+            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+        }
+
+        int node_index = 0;
+        LNode* previous = split_at(index, node_index);
+        if (previous)
+        {
+            previous = own(previous, node_index);
+        }
+        LNode* filled = previous;
+        int filled_count = previous ? previous->count : 0;
+        std::vector<LNode*> added;
+        try
+        {
+            for (; first != last; ++first)
+            {
+                if (!previous || previous->count == asize_)
+                {
+                    LNode* node = allocate_node();
+                    added.push_back(node);
+                    link_after(previous, node);
+                    previous = node;
+                }
+
+                new (&previous->values[previous->count]) T(*first);
+                previous->count++;
+                size_++;
+            }
+        }
+        catch (...)
+        {
+            // The last node is empty if its first item threw
+            if (!added.empty() && previous->count == 0)
+            {
+                unlink_node(previous);
+                release_node(previous);
+                added.pop_back();
+            }
+            if (filled)
+            {
+                index_.add(node_index, filled->count - filled_count);
+            }
+            index_.insert(node_index + 1, added.data(), added.size());
+            throw;
+        }
+
+        if (filled)
+        {
+            index_.add(node_index, filled->count - filled_count);
+        }
+        index_.insert(node_index + 1, added.data(), added.size());
+    }
+
+    // moves the items [first, last) of other to index without copying them, a node at a time
+    // (only the nodes at the ends of the range are split)
+    void splice(int index, Lariat& other, int first, int last)
+    {
+        // Throw exception for bad index
+        if (index < 0 || index > size_ || first < 0 || first > last || last > other.size_)
+        {
+            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+        }
+        if (&other == this)
+        {
+            throw LariatException(
+                LariatException::E_DATA_ERROR, "Can't splice a lariat into itself");
+        }
+        if (first == last)
+        {
+            return;
+        }
+
+        // Everything that can throw comes before any node moves
+        share_pools(other);
+        int node_index = 0;
+        LNode* previous = split_at(index, node_index);
+
+        int before_index = 0;
+        int end_index = 0;
+        LNode* before = other.split_at(first, before_index);
+        LNode* end = other.split_at(last, end_index);
+        std::vector<LNode*> moved;
+        moved.reserve(static_cast<size_t>(end_index - before_index));
+        for (LNode* node = before ? before->next : other.head_; node != end->next; node = node->next)
+        {
+            moved.push_back(node);
+        }
+        index_.reserve_more(moved.size());
+
+        // Take the nodes out of other
+        other.index_.erase(before_index + 1, end_index - before_index);
+        for (size_t i = 0; i < moved.size(); i++)
+        {
+            other.unlink_node(moved[i]);
+        }
+        other.size_ -= last - first;
+
+        // and put them in this one
+        shared_ = shared_ || other.shared_;
+        for (size_t i = 0; i < moved.size(); i++)
+        {
+            link_after(previous, moved[i]);
+            previous = moved[i];
+        }
+        size_ += last - first;
+        index_.insert(node_index + 1, moved.data(), moved.size());
+    }
+
+    // moves all the items of other to index
+    void splice(int index, Lariat& other)
+    {
+        splice(index, other, 0, other.size_);
+    }
+
+    // deletes
+    void erase(int index)
+    {
+        // Throw exception for bad index
+        if (index < 0 || index >= size_)
+        {
+            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+        }
+
+        // If the erase is at the end or beginning, use pop_back or pop_front
+        if (index == size_ - 1)
+        {
+            pop_back();
+            return;
+        }
+        else if (index == 0)
+        {
+            pop_front();
+            return;
+        }
+
+        // Find the node to erase from and the local index within that node
+        int node_index = 0;
+        std::pair<LNode*, int> position = find_element(index, node_index);
+        LNode* current = own(position.first, node_index);
+        int local_index = position.second;
+
+        // Shift all the elements of the node to the left starting at the index
+        current->values[local_index].~T();
+        current->count--;
+        shift_down(current, local_index, 1);
+        index_.add(node_index, -1);
+        size_--;
+
+        // If the node is empty after the erase, delete the node and update the pointers
+        if (current->count == 0)
+        {
+            delete_node(current, node_index);
+        }
+        else
+        {
+            merge_neighbour(current, node_index);
+        }
+    }
+    void pop_back()
+    {
+        // If the list is empty, do nothing
+        if (!head_)
+        {
+            return;
+        }
+
+        int last = index_.size() - 1;
+        own(tail_, last);
+        tail_->values[tail_->count - 1].~T();
+        tail_->count--;
+        index_.add(last, -1);
+        size_--;
+
+        // If the node is now empty, delete the node and update the pointers
+        if (tail_->count == 0)
+        {
+            delete_node(tail_, last);
+        }
+        else
+        {
+            merge_neighbour(tail_, last);
+        }
+    }
+    void pop_front()
+    {
+        // If the list is empty, do nothing
+        if (!head_)
+        {
+            return;
+        }
+
+        // Shift all the elements of the node to the left
+        own(head_, 0);
+        head_->values[0].~T();
+        head_->count--;
+        shift_down(head_, 0, 1);
+        index_.add(0, -1);
+        size_--;
+
+        // If the node is now empty, delete the node and update the pointers
+        if (head_->count == 0)
+        {
+            delete_node(head_, 0);
+        }
+        else
+        {
+            merge_neighbour(head_, 0);
+        }
+    }
+
+    // access
+    T& operator[](int index) // for l-values
+    {
+        check_index(index);
+        int node_index = 0;
+        std::pair<LNode*, int> element = find_element(index, node_index);
+        return own(element.first, node_index)->values[element.second];
+    }
+    const T& operator[](int index) const // for r-values
+    {
+        check_index(index);
+        std::pair<LNode*, int> element = find_element(index);
+        return element.first->values[element.second];
+    }
+
+    T& first()
+    {
+        check_index(0);
+        return own(head_, 0)->values[0];
+    }
+    T const& first() const
+    {
+        check_index(0);
+        return head_->values[0];
+    }
+    T& last()
+    {
+        check_index(size_ - 1);
+        LNode* tail = own(tail_, index_.size() - 1);
+        return tail->values[tail->count - 1];
+    }
+    T const& last() const
+    {
+        check_index(size_ - 1);
+        return tail_->values[tail_->count - 1];
+    }
+
+    // returns index, size (one past last) if not found
+    unsigned find(const T& value) const
+    {
+        int index = 0;
+        for (LNode* current = head_; current; current = current->next)
+        {
+            int found = LariatScan<T>::find(current->values, current->count, value);
+            if (found < current->count)
+            {
+                return static_cast<unsigned>(index + found);
+            }
+            index += current->count;
+        }
+        return static_cast<unsigned>(size());
+    }
+
+    // returns the index of the first item pred is true for, size (one past last) if none
+    template <typename Pred>
+    unsigned find_if(Pred pred) const
+    {
+        int index = 0;
+        for (LNode* current = head_; current; current = current->next)
+        {
+            const T* values = current->values;
+            for (int i = 0; i < current->count; i++)
+            {
+                if (pred(values[i]))
+                {
+                    return static_cast<unsigned>(index + i);
+                }
+            }
+            index += current->count;
+        }
+        return static_cast<unsigned>(size());
+    }
+
+    // returns how many items are equal to value
+    size_t count(const T& value) const
+    {
+        size_t found = 0;
+        for (LNode* current = head_; current; current = current->next)
+        {
+            found += static_cast<size_t>(LariatScan<T>::count(current->values, current->count, value));
+        }
+        return found;
+    }
+
+    // returns how many items pred is true for
+    template <typename Pred>
+    size_t count_if(Pred pred) const
+    {
+        size_t found = 0;
+        for (LNode* current = head_; current; current = current->next)
+        {
+            const T* values = current->values;
+            for (int i = 0; i < current->count; i++)
+            {
+                if (pred(values[i]))
+                {
+                    found++;
+                }
+            }
+        }
+        return found;
+    }
+
+    // returns the smallest and the largest item (throws E_DATA_ERROR if there are none)
+    std::pair<T, T> min_max() const
+    {
+        if (!head_)
+        {
+            throw LariatException(LariatException::E_DATA_ERROR, "Lariat is empty");
+        }
+
+        T min = head_->values[0];
+        T max = head_->values[0];
+        for (LNode* current = head_; current; current = current->next)
+        {
+            LariatScan<T>::min_max(current->values, current->count, min, max);
+        }
+        return std::make_pair(min, max);
+    }
+
+    friend std::ostream& operator<< <T, Size, Allocator, Index>(
+        std::ostream& os, Lariat<T, Size, Allocator, Index> const& list);
+
+    // iterators (the ones that can change items first copy the nodes a snapshot holds)
+    iterator begin()
+    {
+        own_all();
+        return iterator(this, head_, 0, 0);
+    }
+    iterator end()
+    {
+        own_all();
+        return iterator(this, tail_, tail_ ? tail_->count : 0, size_);
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(this, head_, 0, 0);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(this, tail_, tail_ ? tail_->count : 0, size_);
+    }
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    const_iterator cend() const
+    {
+        return end();
+    }
+    reverse_iterator rbegin()
+    {
+        return reverse_iterator(end());
+    }
+    reverse_iterator rend()
+    {
+        return reverse_iterator(begin());
+    }
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    // and some more
+    size_t size(void) const // total number of items (not nodes)
+    {
+        return static_cast<size_t>(size_);
+    }
+
+    Allocator get_allocator() const
+    {
+        return Allocator(allocator_);
+    }
+
+    void clear(void) // make it empty (the nodes stay in the pool)
+    {
+        // Every node goes, so there's no index to keep up along the way
+        while (head_)
+        {
+            LNode* next = head_->next;
+            release_node(head_);
+            head_ = next;
+        }
+        tail_ = nullptr;
+        size_ = 0;
+        nodecount_ = 0;
+        shared_ = false;
+        index_.clear();
+    }
+
+    // When merge is true, erase, pop_front and pop_back merge a node that falls to half full or
+    // less with a neighbour, if their items fit in one node (as a B-tree does), so the nodes stay
+    // over half full on average without calling compact. Off by default. Each merge takes a node
+    // out of the middle of the list, which is O(log nodes) in a rope but costs a
+    // LariatFenwickIndex a rebuild.
+    void merge_underfull(bool merge)
+    {
+        merge_underfull_ = merge;
+    }
+    bool merge_underfull() const
+    {
+        return merge_underfull_;
+    }
+
+    double fill_ratio() const // items over the room the nodes have for them (1 with no nodes)
+    {
+        if (nodecount_ == 0)
+        {
+            return 1.0;
+        }
+        return static_cast<double>(size_) / (static_cast<double>(nodecount_) * asize_);
+    }
+
+    // Takes a snapshot of the items, in O(nodes) and without copying any. Writing through an
+    // iterator made before the snapshot would change it too, so make new ones after taking it.
+    snapshot_type snapshot()
+    {
+        // Nothing that can throw comes after a node is held
+        snapshot_type view;
+        pool();
+        view.pools_.push_back(pool_);
+        view.pools_.insert(view.pools_.end(), other_pools_.begin(), other_pools_.end());
+        view.nodes_.reserve(static_cast<size_t>(nodecount_));
+        view.starts_.reserve(static_cast<size_t>(nodecount_));
+
+        for (LNode* node = head_; node; node = node->next)
+        {
+            if (node->count)
+            {
+                node->refs.fetch_add(1, std::memory_order_relaxed);
+                view.nodes_.push_back(node);
+                view.starts_.push_back(view.size_);
+                view.size_ += node->count;
+            }
+        }
+        shared_ = shared_ || !view.nodes_.empty();
+        return view;
+    }
+
+    void shrink_to_fit() // gives the blocks of the node pool that have no node in use back
+    {
+        if (pool_)
+        {
+            pool_->shrink();
+        }
+    }
+
+    void compact() // push data in front reusing empty positions and delete remaining nodes
+    {
+        own_all();
+
+        // Nearly every count changes, so rebuild the index on the next lookup
+        index_.invalidate();
+
+        // Walk the list with two pointers, one for the current node and one for the next node
+        LNode* left = head_;
+        LNode* right = (head_ != nullptr) ? head_->next : nullptr;
+
+        // Walk the list with both pointers until left isn't already full and next isn't null
+        while (left && right)
+        {
+            if (left->count < asize_)
+            {
+                break;
+            }
+            left = right;
+            right = right->next;
+        }
+
+        // Walk through the list while the next node isn't null
+        while (right)
+        {
+            // Move as many values from the next node to the left node as it has room for
+            int count = right->count;
+            int moved = std::min(asize_ - left->count, count);
+            relocate_items(&left->values[left->count], right->values, moved);
+            left->count += moved;
+            count -= moved;
+
+            right->count = count;
+            shift_down(right, 0, moved);
+
+            if (left->count == asize_)
+            {
+                left = left->next;
+            }
+
+            if (count == 0 || left == right)
+			{
+                right = right->next;
+			}
+        }
+
+        // If there are empty nodes at the end of the list, delete them
+        while (tail_ && tail_->count == 0)
+        {
+            delete_node(tail_, index_.size() - 1);
+        }
+    }
+
+private:
+    struct LNode
+    {
+        LNode()
+        {
+        }
+
+        // destroys the items in use
+        ~LNode()
+        {
+            for (int i = 0; i < count; i++)
+            {
+                values[i].~T();
+            }
+        }
+
+        LNode* next = nullptr;
+        LNode* prev = nullptr;
+        int count = 0;             // number of items currently in the node
+        std::atomic<int> refs{1}; // the lariat and the snapshots holding the node
+
+        // Only the first count values are constructed, the rest is raw storage
+        union
+        {
+            T values[Size];
+        };
+    };
+    // DO NOT modify provided code
+    LNode* head_;           // points to the first node
+    LNode* tail_;           // points to the last node
+    int size_;              // the number of items (not nodes) in the list
+    mutable int nodecount_; // the number of nodes in the list
+    int asize_;             // the size of the array within the nodes
+    bool merge_underfull_;  // merge nodes that fall to half full when items are removed
+    bool shared_;           // some nodes may be held by a snapshot too (own copies them)
+
+    Index<LNode> index_; // counted index over the nodes, so find_element doesn't walk the list
+
+    // Node pool
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<LNode> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    /**
+     * The nodes that aren't in a list, and the blocks all the nodes were allocated in. Nodes
+     * spliced into another lariat stay in their block, so that lariat holds on to the pool too,
+     * and the pool goes with the last lariat holding it.
+     */
+    struct node_pool
+    {
+        typedef std::pair<LNode*, size_t> node_block;
+
+        explicit node_pool(node_allocator const& node_alloc)
+            : allocator(node_alloc), free_nodes(nullptr), returned(nullptr)
+        {
+        }
+
+        node_pool(node_pool const&) = delete;
+        node_pool& operator=(node_pool const&) = delete;
+
+        ~node_pool()
+        {
+            for (size_t i = 0; i < blocks.size(); i++)
+            {
+                free_block(blocks[i]);
+            }
+        }
+
+        /**
+         * @brief Take a node from the pool, first allocating a block of them if it's empty. The
+         * block has as many nodes as the list (up to LARIAT_MAX_BLOCK_NODES), so the pool grows
+         * like the list does.
+         *
+         * @param nodecount the number of nodes in the list
+         * @return an empty node
+         */
+        LNode* allocate(int nodecount)
+        {
+            if (!free_nodes)
+            {
+                take_returned();
+            }
+            if (!free_nodes)
+            {
+                size_t count = static_cast<size_t>(
+                    nodecount < 1 ? 1 : std::min(nodecount, LARIAT_MAX_BLOCK_NODES));
+                blocks.push_back(node_block(nullptr, count));
+                try
+                {
+                    blocks.back().first = node_traits::allocate(allocator, count);
+                }
+                catch (...)
+                {
+                    blocks.pop_back();
+                    throw;
+                }
+
+                LNode* block = blocks.back().first;
+
+                // Link them up back to front, so they're handed out in address order
+                for (size_t i = count; i-- > 0;)
+                {
+                    node_traits::construct(allocator, block + i);
+                    block[i].next = free_nodes;
+                    free_nodes = block + i;
+                }
+            }
+
+            LNode* node = free_nodes;
+            free_nodes = node->next;
+            node->next = nullptr;
+            return node;
+        }
+
+        /**
+         * @brief Destroy the items of a node that's out of the list and put it in the pool
+         *
+         * @param node
+         */
+        void release(LNode* node)
+        {
+            node_traits::destroy(allocator, node);
+            node_traits::construct(allocator, node);
+            node->next = free_nodes;
+            free_nodes = node;
+        }
+
+        /**
+         * @brief Destroy the items of a node a snapshot was the last to hold and put it back.
+         * Snapshots can do this on any thread, so the node waits on a list of its own (pushed on
+         * without a lock, and not touching the allocator) until the lariat next runs out of free
+         * nodes.
+         *
+         * @param node
+         */
+        void give_back(LNode* node)
+        {
+            for (int i = 0; i < node->count; i++)
+            {
+                node->values[i].~T();
+            }
+            node->count = 0;
+            node->prev = nullptr;
+            node->refs.store(1, std::memory_order_relaxed);
+
+            LNode* head = returned.load(std::memory_order_relaxed);
+            do
+            {
+                node->next = head;
+            } while (!returned.compare_exchange_weak(
+                head, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        /**
+         * @brief Move the nodes snapshots gave back to the free nodes
+         */
+        void take_returned()
+        {
+            LNode* node = returned.exchange(nullptr, std::memory_order_acquire);
+            while (node)
+            {
+                LNode* next = node->next;
+                node->next = free_nodes;
+                free_nodes = node;
+                node = next;
+            }
+        }
+
+        /**
+         * @brief Deallocate the blocks that have all their nodes in the pool
+         */
+        void shrink()
+        {
+            take_returned();
+
+            // The blocks in address order, to find which one a node is in
+            std::vector<size_t> order(blocks.size());
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                order[i] = i;
+            }
+            std::less<LNode*> before;
+            std::sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+                return before(blocks[left].first, blocks[right].first);
+            });
+
+            // Nodes from the blocks of other pools count for none
+            std::vector<size_t> unused(blocks.size() + 1, 0);
+            for (LNode* node = free_nodes; node; node = node->next)
+            {
+                unused[block_of(order, node)]++;
+            }
+            unused.back() = 0;
+
+            // Take the nodes of the blocks that go out of the pool, keeping the order of the rest
+            LNode** link = &free_nodes;
+            while (*link)
+            {
+                size_t block = block_of(order, *link);
+                if (block < blocks.size() && unused[block] == blocks[block].second)
+                {
+                    *link = (*link)->next;
+                }
+                else
+                {
+                    link = &(*link)->next;
+                }
+            }
+
+            size_t kept = 0;
+            for (size_t i = 0; i < blocks.size(); i++)
+            {
+                if (unused[i] == blocks[i].second)
+                {
+                    free_block(blocks[i]);
+                }
+                else
+                {
+                    blocks[kept++] = blocks[i];
+                }
+            }
+            blocks.resize(kept);
+        }
+
+        /**
+         * @brief Destroy the nodes of a block, which must all be in the pool, and deallocate it
+         *
+         * @param block
+         */
+        void free_block(node_block const& block)
+        {
+            for (size_t i = 0; i < block.second; i++)
+            {
+                node_traits::destroy(allocator, block.first + i);
+            }
+            node_traits::deallocate(allocator, block.first, block.second);
+        }
+
+        /**
+         * @brief Find the block a node is in
+         *
+         * @param order positions in blocks of the blocks in address order
+         * @param node
+         * @return the position of the block in blocks, or blocks.size() if it's in none of them
+         */
+        size_t block_of(std::vector<size_t> const& order, LNode* node) const
+        {
+            std::less<LNode*> before;
+            std::vector<size_t>::const_iterator after = std::upper_bound(
+                order.begin(), order.end(), node,
+                [&](LNode* left, size_t right) { return before(left, blocks[right].first); });
+            if (after == order.begin())
+            {
+                return blocks.size();
+            }
+
+            node_block const& block = blocks[*(after - 1)];
+            return before(node, block.first + block.second) ? *(after - 1) : blocks.size();
+        }
+
+        node_allocator allocator;       // allocates the blocks of nodes
+        std::vector<node_block> blocks; // every block of nodes, and how many nodes it has
+        LNode* free_nodes;              // the nodes not in a list, linked through next
+        std::atomic<LNode*> returned;   // the nodes snapshots gave back, linked through next
+    };
+
+    node_allocator allocator_;                            // allocates the pool
+    std::shared_ptr<node_pool> pool_;                     // made along with the first node
+    std::vector<std::shared_ptr<node_pool>> other_pools_; // pools of the nodes spliced in
+
+    /**
+     * @brief Swap the nodes (and everything that describes them) with other
+     *
+     * @param other
+     */
+    void swap_contents(Lariat& other) noexcept
+    {
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(size_, other.size_);
+        std::swap(nodecount_, other.nodecount_);
+        std::swap(merge_underfull_, other.merge_underfull_);
+        std::swap(shared_, other.shared_);
+        index_.swap(other.index_);
+        std::swap(allocator_, other.allocator_);
+        pool_.swap(other.pool_);
+        other_pools_.swap(other.other_pools_);
+    }
+
+    /**
+     * @brief The pool of this lariat, made the first time it's needed
+     */
+    node_pool& pool()
+    {
+        if (!pool_)
+        {
+            pool_ = std::allocate_shared<node_pool>(allocator_, allocator_);
+        }
+        return *pool_;
+    }
+
+    LNode* allocate_node()
+    {
+        return pool().allocate(nodecount_);
+    }
+
+    // Puts node back in the pool, unless a snapshot still holds it (the last one to let go of it
+    // gives it back)
+    void release_node(LNode* node)
+    {
+        if (node->refs.load(std::memory_order_acquire) == 1 ||
+            node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            pool().release(node);
+        }
+    }
+
+    /**
+     * @brief Make sure no snapshot holds node, before changing its items. If one does, the node
+     * is copied and the copy takes its place in the list and the index.
+     *
+     * @param node
+     * @param node_index position of node in the index
+     * @return the node to change (node, or its copy)
+     */
+    LNode* own(LNode* node, int node_index)
+    {
+        // Only this lariat holds it, and only this lariat could share it. A lariat that hasn't
+        // been snapshot doesn't even look, as the count is on another cache line than the item.
+        if (!shared_ || node->refs.load(std::memory_order_acquire) == 1)
+        {
+            return node;
+        }
+
+        LNode* copy = allocate_node();
+        try
+        {
+            copy_items(copy->values, node->values, node->count, trivial_items());
+        }
+        catch (...)
+        {
+            release_node(copy);
+            throw;
+        }
+        copy->count = node->count;
+
+        copy->prev = node->prev;
+        copy->next = node->next;
+        (node->prev ? node->prev->next : head_) = copy;
+        (node->next ? node->next->prev : tail_) = copy;
+        index_.replace(node_index, copy);
+        release_node(node);
+        return copy;
+    }
+
+    /**
+     * @brief Copy every node a snapshot holds, before handing out iterators that can change items
+     */
+    void own_all()
+    {
+        if (!shared_)
+        {
+            return;
+        }
+
+        int node_index = 0;
+        for (LNode* node = head_; node; node = node->next)
+        {
+            node = own(node, node_index++);
+        }
+        shared_ = false;
+    }
+
+    /**
+     * @brief Hold on to the pools of other, before taking some of its nodes
+     *
+     * @param other
+     */
+    void share_pools(Lariat& other)
+    {
+        pool();
+        std::vector<std::shared_ptr<node_pool>> pools(other.other_pools_);
+        if (other.pool_)
+        {
+            pools.push_back(other.pool_);
+        }
+
+        for (size_t i = 0; i < pools.size(); i++)
+        {
+            if (pools[i] != pool_ &&
+                std::find(other_pools_.begin(), other_pools_.end(), pools[i]) == other_pools_.end())
+            {
+                other_pools_.push_back(pools[i]);
+            }
+        }
     }
 
-    T& first()
-    {
-        return head_->values[0];
-    }
-    T const& first() const
+    // Whether the values can be moved around as raw bytes (memmove and memcpy)
+    typedef std::integral_constant<bool, std::is_trivially_copyable<T>::value> trivial_items;
+
+    /**
+     * @brief Copy count items to uninitialized storage that doesn't overlap them
+     */
+    static void copy_items(T* destination, const T* source, int count, std::true_type)
     {
-        return head_->values[0];
+        std::memcpy(destination, source, sizeof(T) * static_cast<size_t>(count));
     }
-    T& last()
+    static void copy_items(T* destination, const T* source, int count, std::false_type)
     {
-        return tail_->values[tail_->count - 1];
+        int i = 0;
+        try
+        {
+            for (; i < count; i++)
+            {
+                new (&destination[i]) T(source[i]);
+            }
+        }
+        catch (...)
+        {
+            while (i-- > 0)
+            {
+                destination[i].~T();
+            }
+            throw;
+        }
     }
-    T const& last() const
+
+    template <
+        typename OtherT,
+        int OtherSize,
+        typename OtherAllocator,
+        template <typename> class OtherIndex>
+    void copy_from(Lariat<OtherT, OtherSize, OtherAllocator, OtherIndex> const& copy)
     {
-        return tail_->values[tail_->count - 1];
+        // Values of the same trivial type can be copied a node at a time
+        typedef std::integral_constant<bool, std::is_same<OtherT, T>::value && trivial_items::value>
+            same_trivial;
+        copy_from(copy, same_trivial());
     }
 
-    // returns index, size (one past last) if not found
-    unsigned find(const T& value) const
+    template <
+        typename OtherT,
+        int OtherSize,
+        typename OtherAllocator,
+        template <typename> class OtherIndex>
+    void copy_from(
+        Lariat<OtherT, OtherSize, OtherAllocator, OtherIndex> const& copy, std::false_type)
     {
-        LNode* current = head_;
-        int index = 0;
+        auto* current = copy.head_;
         while (current)
         {
             for (int i = 0; i < current->count; i++)
             {
-                if (current->values[i] == value)
-                {
-                    return index;
-                }
-                index++;
+                push_back(static_cast<T>(current->values[i]));
             }
             current = current->next;
         }
-        return static_cast<unsigned>(size());
     }
 
-    friend std::ostream& operator<< <T, Size>(std::ostream& os, Lariat<T, Size> const& list);
-
-    // and some more
-    size_t size(void) const // total number of items (not nodes)
+    /**
+     * @brief Copy the values of copy a node's worth at a time. The nodes are filled and split just
+     * like push_back would, so the copy looks the same either way.
+     *
+     * @param copy
+     */
+    template <int OtherSize, typename OtherAllocator, template <typename> class OtherIndex>
+    void copy_from(Lariat<T, OtherSize, OtherAllocator, OtherIndex> const& copy, std::true_type)
     {
-        return static_cast<size_t>(size_);
+        for (auto* current = copy.head_; current; current = current->next)
+        {
+            const T* values = current->values;
+            int remaining = current->count;
+            while (remaining > 0)
+            {
+                make_head();
+                int last = index_.size() - 1;
+                if (tail_->count == asize_)
+                {
+                    split_node(tail_, asize_ / 2 + 1, last);
+                    last++;
+                }
+
+                int count = std::min(asize_ - tail_->count, remaining);
+                std::memcpy(
+                    &tail_->values[tail_->count], values, sizeof(T) * static_cast<size_t>(count));
+                tail_->count += count;
+                index_.add(last, count);
+                size_ += count;
+                values += count;
+                remaining -= count;
+            }
+        }
     }
 
-    void clear(void) // make it empty
+    /**
+     * @brief If the list is empty, create a new node and set the head and tail to it
+     */
+    void make_head()
     {
-        while (head_)
+        if (!head_)
         {
-            delete_node(head_);
+            head_ = allocate_node();
+            tail_ = head_;
+            nodecount_++;
+            index_.insert(0, &head_, 1);
         }
-        size_ = 0;
-        nodecount_ = 0;
     }
 
-    void compact() // push data in front reusing empty positions and delete remaining nodes
+    /**
+     * @brief Insert value at index, moving it into the node
+     *
+     * @param index
+     * @param value
+     */
+    void insert_value(int index, T&& value)
     {
-
-        // Walk the list with two pointers, one for the current node and one for the next node
-        LNode* left = head_;
-        LNode* right = (head_ != nullptr) ? head_->next : nullptr;
-
-        // Walk the list with both pointers until left isn't already full and next isn't null
-        while (left && right)
+        // Throw exception for bad index
+        if (index < 0 || index > size_)
         {
-            if (left->count < asize_)
-            {
-                break;
-            }
-            left = right;
-            right = right->next;
+            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
         }
 
-        // Walk through the list while the next node isn't null
-        while (right)
-        {
-            // Store the count of the next node, then set the count to 0
-            int count = right->count;
-            int moved = 0;
-            right->count = 0;
+        make_head();
 
-            // Move the values from the next node to the left node
-            for (int i = 0; count > 0; i++)
-            {
-                if (left->count == asize_)
-                {
-                    break;
-                }
+        // Find the node to insert into and the local index within that node
+        int node_index = 0;
+        std::pair<LNode*, int> position = find_element(index, node_index);
+        LNode* current = own(position.first, node_index);
+        int local_index = position.second;
 
-                left->values[left->count] = std::move(right->values[i]);
-                left->count++;
-                moved++;
-                count--;
+        // If the node is full, split it first. Wherever the value goes, the left node ends up with
+        // asize_ / 2 + 1 items.
+        if (current->count == asize_)
+        {
+            int split_index = static_cast<int>(asize_ / 2 + 1);
+            if (local_index < split_index)
+            {
+                split_node(current, split_index - 1, node_index);
             }
-
-            right->count = count;
-            shift_down(right, 0, moved);
-
-            if (left->count == asize_)
+            else
             {
-                left = left->next;
+                split_node(current, split_index, node_index);
+                local_index -= split_index;
+                current = current->next;
+                node_index++;
             }
-
-            if (count == 0 || left == right)
-			{
-                right = right->next;
-			}
         }
 
-        // If there are empty nodes at the end of the list, delete them
-        while (tail_ && tail_->count == 0)
+        // Shift all the elements of the node to the right starting at the index, and put the value
+        // in the slot that opens up
+        shift_up(current, local_index);
+        try
+        {
+            new (&current->values[local_index]) T(std::move(value));
+        }
+        catch (...)
         {
-            delete_node(tail_);
+            shift_down(current, local_index, 1);
+            throw;
         }
+        current->count++;
+        index_.add(node_index, 1);
+        size_++;
     }
 
-private:
-    struct LNode
-    { // DO NOT modify provided code
-        LNode* next = nullptr;
-        LNode* prev = nullptr;
-        int count = 0; // number of items currently in the node
-        T values[Size];
-    };
-    // DO NOT modify provided code
-    LNode* head_;           // points to the first node
-    LNode* tail_;           // points to the last node
-    int size_;              // the number of items (not nodes) in the list
-    mutable int nodecount_; // the number of nodes in the list
-    int asize_;             // the size of the array within the nodes
+    /**
+     * @brief Find the node and the local index within that node for a given index
+     *
+     * @param index
+     * @return std::pair<LNode*, int>
+     */
+    std::pair<LNode*, int> find_element(int index) const
+    {
+        int node_index = 0;
+        return find_element(index, node_index);
+    }
 
-    template <typename OtherT, int OtherSize>
-    void copy_from(Lariat<OtherT, OtherSize> const& copy)
+    /**
+     * @brief Throw E_BAD_INDEX unless index is the index of an item. Only the inserts take size_
+     * (one past the last item), so everything that reads or writes an item checks with this first.
+     *
+     * @param index
+     */
+    void check_index(int index) const
     {
-        // typename Lariat<OtherT, OtherSize>::LNode* current = copy.head_;
-        auto* current = copy.head_;
-        while (current)
+        if (index < 0 || index >= size_)
         {
-            for (int i = 0; i < current->count; i++)
-            {
-                push_back(static_cast<T>(current->values[i]));
-            }
-            current = current->next;
+            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
         }
     }
 
     /**
-     * @brief Find the node and the local index within that node for a given index
+     * @brief Find the node and the local index within that node for a given index, in
+     * O(log nodes) with the counted index, and set node_index to the node's position. index may
+     * be size_, which is one past the last item of the tail (where an insert at the end goes).
      *
      * @param index
+     * @param node_index
      * @return std::pair<LNode*, int>
      */
-    std::pair<LNode*, int> find_element(int index) const
+    std::pair<LNode*, int> find_element(int index, int& node_index) const
     {
-        LNode* current = head_;
+        node_index = 0;
 
-        // if current is null, return the tail and the index
-        if (!current)
+        // if the list is empty, return the tail and the index
+        if (!head_)
         {
             return std::make_pair(tail_, index);
         }
 
+        // The ends are where most of the changes happen, and they don't need the index (which
+        // may be waiting to be rebuilt)
         if (index == size_)
         {
+            node_index = index_.size() - 1;
             return std::make_pair(tail_, tail_->count);
         }
 
-        while (current != nullptr)
+        if (index == 0)
         {
-            if (index < current->count)
-            {
-                return std::make_pair(current, index);
-            }
+            return std::make_pair(head_, 0);
+        }
 
-            index -= current->count;
-            current = current->next;
+        if (index < 0 || index > size_)
+        {
+            throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
         }
 
-        throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+        LNode* node = index_.find(index, node_index);
+        return std::make_pair(node, index);
     }
 
     /**
-     * @brief Shift the elements of the node to the right starting at the index
+     * @brief Shift the elements of the node to the right starting at the index, leaving the slot at
+     * the index unconstructed. The node must have room for one more.
      *
      * @param currentNode
      * @param index
      */
     void shift_up(LNode* currentNode, int index)
     {
-        int n = currentNode->count;
-        if (currentNode->count == asize_)
-        {
-            --n;
-        }
-
-        for (int i = index; i < n; i++)
-        {
-            std::swap(currentNode->values[index], currentNode->values[i + 1]);
-        }
+        shift_items(
+            &currentNode->values[index + 1], &currentNode->values[index],
+            currentNode->count - index);
     }
 
     /**
      * @brief Shift the elements of the node to the left starting at the index and given an offset,
-     * which is the number of elements to shift
+     * which is the number of elements to shift, into the unconstructed slots at the index. The
+     * node's count must already be the count after the shift.
      *
      * @param currentNode
      * @param index
@@ -473,58 +2938,223 @@ private:
             return;
         }
 
-        // Shift the elements of the node to the left starting at the index, up to the count minus
-        // the offset
-        for (int i = index; i < asize_ - offset; i++)
+        shift_items(
+            &currentNode->values[index], &currentNode->values[index + offset],
+            currentNode->count - index);
+    }
+
+    /**
+     * @brief Move count values from source to destination, which may overlap. The destination
+     * slots the source doesn't cover must be unconstructed, and the source slots the destination
+     * doesn't cover are left unconstructed.
+     *
+     * @param destination
+     * @param source
+     * @param count
+     */
+    static void shift_items(T* destination, T* source, int count)
+    {
+        shift_items(destination, source, count, trivial_items());
+    }
+
+    static void shift_items(T* destination, T* source, int count, std::true_type)
+    {
+        if (count > 0)
+        {
+            std::memmove(destination, source, sizeof(T) * static_cast<size_t>(count));
+        }
+    }
+
+    static void shift_items(T* destination, T* source, int count, std::false_type)
+    {
+        if (destination < source)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                relocate_item(destination + i, source + i);
+            }
+        }
+        else
+        {
+            for (int i = count - 1; i >= 0; i--)
+            {
+                relocate_item(destination + i, source + i);
+            }
+        }
+    }
+
+    /**
+     * @brief Move count values from source to the unconstructed slots at destination, which don't
+     * overlap. The source slots are left unconstructed.
+     *
+     * @param destination
+     * @param source
+     * @param count
+     */
+    static void relocate_items(T* destination, T* source, int count)
+    {
+        relocate_items(destination, source, count, trivial_items());
+    }
+
+    static void relocate_items(T* destination, T* source, int count, std::true_type)
+    {
+        if (count > 0)
+        {
+            std::memcpy(destination, source, sizeof(T) * static_cast<size_t>(count));
+        }
+    }
+
+    static void relocate_items(T* destination, T* source, int count, std::false_type)
+    {
+        for (int i = 0; i < count; i++)
         {
-            std::swap(currentNode->values[i], currentNode->values[i + offset]);
+            relocate_item(destination + i, source + i);
         }
     }
 
+    /**
+     * @brief Move construct destination from source, then destroy source
+     *
+     * @param destination
+     * @param source
+     */
+    static void relocate_item(T* destination, T* source)
+    {
+        new (destination) T(std::move(*source));
+        source->~T();
+    }
+
     /**
      * @brief Split the node at the index
      *
      * @param currentNode
      * @param index
+     * @param node_index position of currentNode in the index
      */
-    void split_node(LNode* currentNode, int index)
+    void split_node(LNode* currentNode, int index, int node_index)
     {
         // Make a new node
-        LNode* new_node = new LNode;
-        new_node->next = currentNode->next;
-        new_node->prev = currentNode;
-        currentNode->next = new_node;
+        LNode* new_node = allocate_node();
+        link_after(currentNode, new_node);
+
+        int count = currentNode->count - index;
+        relocate_items(new_node->values, &currentNode->values[index], count);
+        new_node->count = count;
+        currentNode->count = index;
 
-        // If the new node isn't the last node, set the next node's previous to the new node
-        if (new_node->next)
+        index_.add(node_index, -count);
+        index_.insert(node_index + 1, &new_node, 1);
+    }
+
+    /**
+     * @brief Split the node holding the item at index, so that item starts a node
+     *
+     * @param index
+     * @param node_index set to the position of the node before the item
+     * @return the node before the item (null if index is 0)
+     */
+    LNode* split_at(int index, int& node_index)
+    {
+        node_index = -1;
+        if (index == 0)
         {
-            new_node->next->prev = new_node;
+            return nullptr;
         }
 
-        int count = 0;
+        std::pair<LNode*, int> position = find_element(index, node_index);
+        if (position.second == 0)
+        {
+            node_index--;
+            return position.first->prev;
+        }
+        if (position.second < position.first->count)
+        {
+            LNode* node = own(position.first, node_index);
+            split_node(node, position.second, node_index);
+            return node;
+        }
+        return position.first;
+    }
 
-        for (int i = index; i < currentNode->count; i++)
+    /**
+     * @brief Link node into the list after previous, or at the front if previous is null
+     *
+     * @param previous
+     * @param node
+     */
+    void link_after(LNode* previous, LNode* node)
+    {
+        node->prev = previous;
+        node->next = previous ? previous->next : head_;
+        if (node->next)
         {
-            new_node->values[count] = std::move(currentNode->values[i]);
-            count++;
+            node->next->prev = node;
+        }
+        else
+        {
+            tail_ = node;
+        }
+
+        if (previous)
+        {
+            previous->next = node;
+        }
+        else
+        {
+            head_ = node;
         }
-        new_node->count = count;
-        currentNode->count = index;
         nodecount_++;
+    }
+
+    /**
+     * @brief Merge node with its next or previous node, if it's half full or less and their items
+     * fit in one node
+     *
+     * @param node
+     * @param node_index position of node in the index
+     */
+    void merge_neighbour(LNode* node, int node_index)
+    {
+        if (!merge_underfull_ || node->count > asize_ / 2)
+        {
+            return;
+        }
 
-        // If the last node is split, set the tail to the new node
-        if (currentNode == tail_)
+        if (node->next && node->count + node->next->count <= asize_)
+        {
+            merge_nodes(node, node->next, node_index);
+        }
+        else if (node->prev && node->prev->count + node->count <= asize_)
         {
-            tail_ = new_node;
+            merge_nodes(node->prev, node, node_index - 1);
         }
     }
 
     /**
-     * @brief Delete a node
+     * @brief Move the items of right to the end of left, and delete right
+     *
+     * @param left
+     * @param right the node after left
+     * @param left_index position of left in the index
+     */
+    void merge_nodes(LNode* left, LNode* right, int left_index)
+    {
+        left = own(left, left_index);
+        right = own(right, left_index + 1);
+        int count = right->count;
+        relocate_items(&left->values[left->count], right->values, count);
+        left->count += count;
+        right->count = 0;
+        index_.add(left_index, count);
+        delete_node(right, left_index + 1);
+    }
+
+    /**
+     * @brief Take node out of the list (but not out of the index)
      *
      * @param node
      */
-    void delete_node(LNode* node)
+    void unlink_node(LNode* node)
     {
         if (node->prev)
         {
@@ -545,10 +3175,24 @@ private:
         {
             tail_ = node->prev;
         }
-
-        delete node;
+        node->next = nullptr;
+        node->prev = nullptr;
         nodecount_--;
     }
+
+    /**
+     * @brief Delete a node
+     *
+     * @param node
+     * @param node_index position of node in the index
+     */
+    void delete_node(LNode* node, int node_index)
+    {
+        unlink_node(node);
+        release_node(node);
+
+        index_.erase(node_index);
+    }
 };
 
 #include "lariat.cpp"
@@ -0,0 +1,192 @@
+// Measures the operations of Lariat that shift, split, compact, copy and
+// scan values, with nodes from 64 to 4096 values. Each one runs with int, which
+// Lariat moves around with memmove and memcpy and scans with SIMD, and
+// with an int that isn't trivially copyable, which it moves and compares one
+// value at a time, so the rows show what the fast paths are worth. The fenwick
+// and rope rows are int again, with the list kept in a LariatFenwickIndex or a
+// LariatRopeIndex from the start. The fill ratio after the erases, with and
+// without merge_underfull, goes to stderr. Writes CSV to stdout. Build with
+// "g++ -std=c++11 -O2 lariatbench.cpp -o lariatbench" and pass the number
+// of values (default 1M) on the command line.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "lariat.h"
+
+//! Times each scan (find, count, min_max) runs over the whole list
+const int SCAN_PASSES = 10;
+
+//! An int with a copy constructor, so it takes the value at a time path
+struct BoxedInt
+{
+    int Value;
+
+    BoxedInt(int value = 0) : Value(value)
+    {
+    }
+    BoxedInt(const BoxedInt& rhs) : Value(rhs.Value)
+    {
+    }
+    BoxedInt& operator=(const BoxedInt& rhs)
+    {
+        Value = rhs.Value;
+        return *this;
+    }
+    bool operator==(const BoxedInt& rhs) const
+    {
+        return Value == rhs.Value;
+    }
+    bool operator<(const BoxedInt& rhs) const
+    {
+        return Value < rhs.Value;
+    }
+};
+
+int ValueOf(int value)
+{
+    return value;
+}
+
+int ValueOf(const BoxedInt& value)
+{
+    return value.Value;
+}
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Times Op() over Count operations and prints its row
+template <typename F>
+void Measure(const char* Operation, const char* Type, int Size, int Count, F Op)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long sink = Op();
+    double seconds = Seconds(start);
+    std::printf(
+        "%s,%s,%d,%d,%.2f\n",
+        Operation,
+        Type,
+        Size,
+        Count,
+        seconds * 1e9 / static_cast<double>(Count));
+
+    // Keep the work from being optimized away
+    if (sink == 1)
+        std::fprintf(stderr, " ");
+}
+
+template <typename T, int Size, template <typename> class Index = LariatAdaptiveIndex>
+void Run(const char* Type, int Count, const std::vector<int>& positions)
+{
+    typedef Lariat<T, Size, std::allocator<T>, Index> List;
+    List list;
+    auto size = [&]() { return static_cast<int>(list.size()); };
+    Measure("insert_random", Type, Size, Count, [&]() {
+        for (size_t i = 0; i < static_cast<size_t>(Count); i++)
+            list.insert(positions[i] % (size() + 1), T(static_cast<int>(i)));
+        return static_cast<long long>(list.size());
+    });
+
+    // Nothing is -1, so find looks at every value
+    Measure("find_missing", Type, Size, Count * SCAN_PASSES, [&]() {
+        long long found = 0;
+        for (int pass = 0; pass < SCAN_PASSES; pass++)
+            found += list.find(T(-1));
+        return found;
+    });
+
+    Measure("count", Type, Size, Count * SCAN_PASSES, [&]() {
+        long long found = 0;
+        for (int pass = 0; pass < SCAN_PASSES; pass++)
+            found += static_cast<long long>(list.count(T(pass)));
+        return found;
+    });
+
+    Measure("min_max", Type, Size, Count * SCAN_PASSES, [&]() {
+        long long found = 0;
+        for (int pass = 0; pass < SCAN_PASSES; pass++)
+            found += ValueOf(list.min_max().second);
+        return found;
+    });
+
+    Measure("read_random", Type, Size, Count, [&]() {
+        long long sum = 0;
+        for (size_t i = 0; i < static_cast<size_t>(Count); i++)
+            sum += ValueOf(list[positions[i] % size()]);
+        return sum;
+    });
+
+    Measure("copy", Type, Size, Count, [&]() {
+        List copy(list);
+        return static_cast<long long>(copy.size());
+    });
+
+    // Shares the nodes instead of copying the values
+    Measure("snapshot", Type, Size, Count, [&]() {
+        typename List::snapshot_type view = list.snapshot();
+        return static_cast<long long>(view.size());
+    });
+
+    // The same erases with merge_underfull, on a copy
+    List merged(list);
+    merged.merge_underfull(true);
+    Measure("erase_merge", Type, Size, Count / 2, [&]() {
+        for (size_t i = 0; i < static_cast<size_t>(Count / 2); i++)
+            merged.erase(positions[i] % static_cast<int>(merged.size()));
+        return static_cast<long long>(merged.size());
+    });
+    std::fprintf(stderr, "%s %d: fill %.2f after erase_merge\n", Type, Size, merged.fill_ratio());
+
+    // Erasing half of the values leaves the nodes about half full
+    Measure("erase_random", Type, Size, Count / 2, [&]() {
+        for (size_t i = 0; i < static_cast<size_t>(Count / 2); i++)
+            list.erase(positions[i] % size());
+        return static_cast<long long>(list.size());
+    });
+
+    std::fprintf(stderr, "%s %d: fill %.2f after erase_random\n", Type, Size, list.fill_ratio());
+    Measure("compact", Type, Size, Count / 2, [&]() {
+        list.compact();
+        return static_cast<long long>(list.size());
+    });
+
+    List front;
+    Measure("push_front", Type, Size, Count, [&]() {
+        for (int i = 0; i < Count; i++)
+            front.push_front(T(i));
+        return static_cast<long long>(ValueOf(front.first()));
+    });
+}
+
+template <int Size>
+void RunBoth(int Count, const std::vector<int>& positions)
+{
+    Run<int, Size>("int", Count, positions);
+    Run<BoxedInt, Size>("boxed", Count, positions);
+    Run<int, Size, LariatFenwickIndex>("fenwick", Count, positions);
+    Run<int, Size, LariatRopeIndex>("rope", Count, positions);
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    int count = 1 << 20;
+    if (argc > 1)
+        count = std::atoi(argv[1]);
+
+    std::mt19937 rng(1);
+    std::vector<int> positions(static_cast<size_t>(count));
+    for (int i = 0; i < count; i++)
+        positions[static_cast<size_t>(i)] = static_cast<int>(rng() % static_cast<unsigned>(count));
+
+    std::printf("operation,type,size,count,ns_per_value\n");
+    RunBoth<64>(count, positions);
+    RunBoth<512>(count, positions);
+    RunBoth<4096>(count, positions);
+    return 0;
+}
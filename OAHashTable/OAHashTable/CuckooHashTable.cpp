@@ -0,0 +1,508 @@
+#include "CuckooHashTable.h"
+#include <cmath>
+#include <new>
+
+template <typename T>
+CuckooHashTable<T>::CuckooHashTable(const OAHTConfig& Config)
+    : Config_(Config), BucketMemory_(nullptr), Buckets_(nullptr), BucketCount_(0),
+      Random_(0x9e3779b9), StashCount_(0), Keys_(nullptr), KeysUsed_(0), KeysCapacity_(0),
+      KeysDead_(0)
+{
+    Stats_.PrimaryHashFunc_ = Config_.PrimaryHashFunc_;
+    Stats_.SecondaryHashFunc_ = Config_.SecondaryHashFunc_;
+
+    // At least two buckets, so every key has two different ones
+    unsigned buckets = GetNextPowerOfTwo(
+        (Config_.InitialTableSize_ + CUCKOO_BUCKET_SLOTS - 1) / CUCKOO_BUCKET_SLOTS);
+    AllocateBuckets(buckets < 2 ? 2 : buckets);
+
+    try
+    {
+        Keys_ = new char[KEY_ARENA_SIZE];
+    }
+    catch (std::bad_alloc&)
+    {
+        FreeBuckets();
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Out of memory allocating the table");
+    }
+    KeysCapacity_ = KEY_ARENA_SIZE;
+}
+
+template <typename T>
+CuckooHashTable<T>::~CuckooHashTable()
+{
+    clear();
+    FreeBuckets();
+    delete[] Keys_;
+}
+
+template <typename T>
+void CuckooHashTable<T>::insert(const char* Key, const T& Data)
+{
+    Bucket* where = nullptr;
+    if (Locate(Key, where) != -1)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_DUPLICATE, "Item being inserted is a duplicate");
+    }
+
+    // Grow first if this item would push us past the max load factor
+    double loadFactor = static_cast<double>(Stats_.Count_ + 1) / Stats_.TableSize_;
+    if (loadFactor > Config_.MaxLoadFactor_)
+    {
+        Resize(BucketCount_ * 2, nullptr);
+    }
+
+    Entry item;
+    item.Hash = HashOf(Key);
+    item.Key = StoreKey(Key);
+    item.Data = Data;
+
+    // Place can leave some other item without a place, which the bigger
+    // table then takes
+    if (!Place(item))
+    {
+        Resize(BucketCount_ * 2, &item);
+    }
+    Stats_.Count_++;
+}
+
+template <typename T>
+void CuckooHashTable<T>::remove(const char* Key)
+{
+    Bucket* where = nullptr;
+    int slot = Locate(Key, where);
+    if (slot == -1)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+    }
+
+    if (where)
+    {
+        if (Config_.FreeProc_)
+        {
+            Config_.FreeProc_(where->Data[slot]);
+        }
+        ReleaseKey(where->Keys[slot]);
+        where->Keys[slot] = EMPTY;
+    }
+    else
+    {
+        if (Config_.FreeProc_)
+        {
+            Config_.FreeProc_(Stash_[slot].Data);
+        }
+        ReleaseKey(Stash_[slot].Key);
+        Stash_[slot] = Stash_[--StashCount_];
+    }
+    Stats_.Count_--;
+
+    // Don't let the arena fill up with the keys of removed items
+    if (KeysUsed_ >= KEY_ARENA_SIZE && KeysDead_ > KeysUsed_ / 2)
+    {
+        CompactKeys();
+    }
+}
+
+template <typename T>
+const T& CuckooHashTable<T>::find(const char* Key) const
+{
+    Bucket* where = nullptr;
+    int slot = Locate(Key, where);
+    if (slot == -1)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+    }
+    return where ? where->Data[slot] : Stash_[slot].Data;
+}
+
+template <typename T>
+void CuckooHashTable<T>::clear()
+{
+    for (unsigned i = 0; i < BucketCount_; i++)
+    {
+        for (unsigned slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+        {
+            if (Buckets_[i].Keys[slot] != EMPTY && Config_.FreeProc_)
+            {
+                Config_.FreeProc_(Buckets_[i].Data[slot]);
+            }
+            Buckets_[i].Keys[slot] = EMPTY;
+        }
+    }
+    for (unsigned i = 0; i < StashCount_ && Config_.FreeProc_; i++)
+    {
+        Config_.FreeProc_(Stash_[i].Data);
+    }
+
+    StashCount_ = 0;
+    Stats_.Count_ = 0;
+    KeysUsed_ = 0;
+    KeysDead_ = 0;
+}
+
+template <typename T>
+OAHTStats CuckooHashTable<T>::GetStats() const
+{
+    return Stats_;
+}
+
+template <typename T>
+unsigned CuckooHashTable<T>::GetStashCount() const
+{
+    return StashCount_;
+}
+
+template <typename T>
+void CuckooHashTable<T>::AllocateBuckets(unsigned Count)
+{
+    // new only promises alignment for the types in Bucket, so line the
+    // buckets up with the cache lines by hand
+    const std::size_t line = 64;
+    try
+    {
+        BucketMemory_ = new char[Count * sizeof(Bucket) + line - 1];
+    }
+    catch (std::bad_alloc&)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Out of memory allocating the table");
+    }
+
+    std::size_t address = reinterpret_cast<std::size_t>(BucketMemory_);
+    Buckets_ = reinterpret_cast<Bucket*>((address + line - 1) & ~(line - 1));
+    for (unsigned i = 0; i < Count; i++)
+    {
+        new (&Buckets_[i]) Bucket();
+        for (unsigned slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+        {
+            Buckets_[i].Keys[slot] = EMPTY;
+        }
+    }
+
+    BucketCount_ = Count;
+    Stats_.TableSize_ = Count * CUCKOO_BUCKET_SLOTS;
+}
+
+template <typename T>
+void CuckooHashTable<T>::FreeBuckets()
+{
+    for (unsigned i = 0; i < BucketCount_; i++)
+    {
+        Buckets_[i].~Bucket();
+    }
+    delete[] BucketMemory_;
+    BucketMemory_ = nullptr;
+    Buckets_ = nullptr;
+    BucketCount_ = 0;
+}
+
+template <typename T>
+unsigned CuckooHashTable<T>::HashOf(const char* Key) const
+{
+    return static_cast<unsigned>(OAHTMix(Config_.PrimaryHashFunc_(Key, ~0u)));
+}
+
+template <typename T>
+unsigned CuckooHashTable<T>::FirstBucket(unsigned Hash) const
+{
+    return Hash & (BucketCount_ - 1);
+}
+
+template <typename T>
+unsigned CuckooHashTable<T>::SecondBucket(const char* Key, unsigned Hash) const
+{
+    // Without a second function, mix the first hash again
+    unsigned long long hash = ~static_cast<unsigned long long>(Hash);
+    if (Config_.SecondaryHashFunc_)
+    {
+        hash = Config_.SecondaryHashFunc_(Key, ~0u);
+    }
+
+    // Two choices only help if they're different buckets
+    unsigned first = FirstBucket(Hash);
+    unsigned second = static_cast<unsigned>(OAHTMix(hash)) & (BucketCount_ - 1);
+    return second != first ? second : first ^ 1;
+}
+
+template <typename T>
+typename CuckooHashTable<T>::KeyWord CuckooHashTable<T>::InlineKey(
+    const char* Key,
+    unsigned Length)
+{
+    KeyWord word = 0;
+    std::memcpy(&word, Key, Length);
+    return word;
+}
+
+template <typename T>
+typename CuckooHashTable<T>::KeyWord CuckooHashTable<T>::ArenaKey(unsigned Offset)
+{
+    unsigned char bytes[sizeof(KeyWord)] = {0};
+    std::memcpy(bytes, &Offset, sizeof(Offset));
+    bytes[sizeof(KeyWord) - 1] = 0xff;
+
+    KeyWord word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+template <typename T>
+unsigned CuckooHashTable<T>::ArenaOffset(KeyWord Word)
+{
+    unsigned char bytes[sizeof(KeyWord)];
+    std::memcpy(bytes, &Word, sizeof(bytes));
+    if (bytes[sizeof(KeyWord) - 1] == 0)
+    {
+        return ~0u;
+    }
+
+    unsigned offset;
+    std::memcpy(&offset, bytes, sizeof(offset));
+    return offset;
+}
+
+template <typename T>
+const char* CuckooHashTable<T>::KeyText(const KeyWord& Word) const
+{
+    unsigned offset = ArenaOffset(Word);
+    return offset == ~0u ? reinterpret_cast<const char*>(&Word) : Keys_ + offset;
+}
+
+template <typename T>
+typename CuckooHashTable<T>::KeyWord CuckooHashTable<T>::StoreKey(const char* Key)
+{
+    unsigned length = static_cast<unsigned>(std::strlen(Key));
+    if (length < CUCKOO_INLINE_KEY)
+    {
+        return InlineKey(Key, length);
+    }
+    return ArenaKey(OAHTAppendKey(Keys_, KeysUsed_, KeysCapacity_, Key, length));
+}
+
+template <typename T>
+void CuckooHashTable<T>::ReleaseKey(KeyWord Word)
+{
+    unsigned offset = ArenaOffset(Word);
+    if (offset != ~0u)
+    {
+        KeysDead_ += static_cast<unsigned>(std::strlen(Keys_ + offset)) + 1;
+    }
+}
+
+template <typename T>
+int CuckooHashTable<T>::Locate(const char* Key, Bucket*& Where) const
+{
+    unsigned hash = HashOf(Key);
+    unsigned first = FirstBucket(hash);
+    unsigned second = SecondBucket(Key, hash);
+
+    // A short key is found by comparing words. A long one is compared in
+    // the arena, and only where the hash matches.
+    std::size_t length = std::strlen(Key);
+    bool inlined = length < CUCKOO_INLINE_KEY;
+    KeyWord word = inlined ? InlineKey(Key, static_cast<unsigned>(length)) : EMPTY;
+
+    // Both buckets are loaded at the same time
+    OAHTPrefetch(&Buckets_[second]);
+    for (unsigned index = first;; index = second)
+    {
+        Stats_.Probes_++;
+        Bucket& bucket = Buckets_[index];
+        for (unsigned slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+        {
+            KeyWord stored = bucket.Keys[slot];
+            if (inlined ? stored == word
+                        : stored != EMPTY && bucket.Hashes[slot] == hash &&
+                              std::strcmp(KeyText(stored), Key) == 0)
+            {
+                Where = &bucket;
+                return static_cast<int>(slot);
+            }
+        }
+
+        if (index == second)
+        {
+            break;
+        }
+    }
+
+    Where = nullptr;
+    for (unsigned i = 0; i < StashCount_; i++)
+    {
+        if (inlined ? Stash_[i].Key == word
+                    : Stash_[i].Hash == hash && std::strcmp(KeyText(Stash_[i].Key), Key) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+template <typename T>
+bool CuckooHashTable<T>::AddToBucket(unsigned Index, const Entry& Item)
+{
+    Bucket& bucket = Buckets_[Index];
+    for (unsigned slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+    {
+        if (bucket.Keys[slot] == EMPTY)
+        {
+            bucket.Hashes[slot] = Item.Hash;
+            bucket.Keys[slot] = Item.Key;
+            bucket.Data[slot] = Item.Data;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+bool CuckooHashTable<T>::Place(Entry& Item)
+{
+    unsigned first = FirstBucket(Item.Hash);
+    unsigned index = SecondBucket(KeyText(Item.Key), Item.Hash);
+    if (AddToBucket(first, Item) || AddToBucket(index, Item))
+    {
+        return true;
+    }
+
+    // Both are full: swap the item for one in the second bucket, which
+    // then tries its own other bucket, and so on
+    for (unsigned kick = 0; kick < CUCKOO_MAX_KICKS; kick++)
+    {
+        Random_ ^= Random_ << 13;
+        Random_ ^= Random_ >> 17;
+        Random_ ^= Random_ << 5;
+        unsigned slot = Random_ % CUCKOO_BUCKET_SLOTS;
+
+        Bucket& bucket = Buckets_[index];
+        Entry moved;
+        moved.Hash = bucket.Hashes[slot];
+        moved.Key = bucket.Keys[slot];
+        moved.Data = bucket.Data[slot];
+        bucket.Hashes[slot] = Item.Hash;
+        bucket.Keys[slot] = Item.Key;
+        bucket.Data[slot] = Item.Data;
+        Item = moved;
+
+        first = FirstBucket(Item.Hash);
+        unsigned second = SecondBucket(KeyText(Item.Key), Item.Hash);
+        index = index == first ? second : first;
+        if (AddToBucket(index, Item))
+        {
+            return true;
+        }
+    }
+
+    if (StashCount_ < CUCKOO_STASH_SIZE)
+    {
+        Stash_[StashCount_++] = Item;
+        return true;
+    }
+    return false;
+}
+
+template <typename T>
+void CuckooHashTable<T>::Resize(unsigned Count, const Entry* Extra)
+{
+    char* oldMemory = BucketMemory_;
+    Bucket* oldBuckets = Buckets_;
+    unsigned oldCount = BucketCount_;
+    Entry oldStash[CUCKOO_STASH_SIZE];
+    unsigned oldStashCount = StashCount_;
+    for (unsigned i = 0; i < StashCount_; i++)
+    {
+        oldStash[i] = Stash_[i];
+    }
+
+    // Very unlucky hashing can need more than one doubling
+    for (;; Count *= 2)
+    {
+        try
+        {
+            AllocateBuckets(Count);
+        }
+        catch (OAHashTableException&)
+        {
+            BucketMemory_ = oldMemory;
+            Buckets_ = oldBuckets;
+            BucketCount_ = oldCount;
+            Stats_.TableSize_ = oldCount * CUCKOO_BUCKET_SLOTS;
+            for (unsigned i = 0; i < oldStashCount; i++)
+            {
+                Stash_[i] = oldStash[i];
+            }
+            StashCount_ = oldStashCount;
+            throw;
+        }
+        StashCount_ = 0;
+
+        bool placed = true;
+        for (unsigned i = 0; i < oldCount && placed; i++)
+        {
+            for (unsigned slot = 0; slot < CUCKOO_BUCKET_SLOTS && placed; slot++)
+            {
+                if (oldBuckets[i].Keys[slot] != EMPTY)
+                {
+                    Entry item;
+                    item.Hash = oldBuckets[i].Hashes[slot];
+                    item.Key = oldBuckets[i].Keys[slot];
+                    item.Data = oldBuckets[i].Data[slot];
+                    placed = Place(item);
+                }
+            }
+        }
+        for (unsigned i = 0; i < oldStashCount && placed; i++)
+        {
+            Entry item = oldStash[i];
+            placed = Place(item);
+        }
+        if (Extra && placed)
+        {
+            Entry item = *Extra;
+            placed = Place(item);
+        }
+
+        if (placed)
+        {
+            break;
+        }
+        FreeBuckets();
+    }
+
+    for (unsigned i = 0; i < oldCount; i++)
+    {
+        oldBuckets[i].~Bucket();
+    }
+    delete[] oldMemory;
+    Stats_.Expansions_++;
+}
+
+template <typename T>
+void CuckooHashTable<T>::CompactKeys()
+{
+    OAHTCompactKeys(Keys_, KeysUsed_, KeysCapacity_, KeysDead_, [this](auto Move) {
+        auto moveKey = [&](KeyWord& Word) {
+            unsigned offset = ArenaOffset(Word);
+            if (Word != EMPTY && offset != ~0u)
+            {
+                unsigned length = static_cast<unsigned>(std::strlen(Keys_ + offset));
+                Word = ArenaKey(Move(offset, length));
+            }
+        };
+        for (unsigned i = 0; i < BucketCount_; i++)
+        {
+            for (unsigned slot = 0; slot < CUCKOO_BUCKET_SLOTS; slot++)
+            {
+                moveKey(Buckets_[i].Keys[slot]);
+            }
+        }
+        for (unsigned i = 0; i < StashCount_; i++)
+        {
+            moveKey(Stash_[i].Key);
+        }
+    });
+}
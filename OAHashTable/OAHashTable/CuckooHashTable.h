@@ -0,0 +1,192 @@
+//---------------------------------------------------------------------------
+#ifndef CUCKOOHASHTABLEH
+#define CUCKOOHASHTABLEH
+//---------------------------------------------------------------------------
+#include "OAHashTable.h"
+
+//! Number of slots in each bucket of a CuckooHashTable
+const unsigned CUCKOO_BUCKET_SLOTS = 4;
+
+//! Number of items a CuckooHashTable keeps aside when they won't fit
+const unsigned CUCKOO_STASH_SIZE = 4;
+
+//! Number of items an insert moves before it gives up and uses the stash
+const unsigned CUCKOO_MAX_KICKS = 256;
+
+//! Keys shorter than this are kept in their bucket instead of the key arena
+const unsigned CUCKOO_INLINE_KEY = 8;
+
+/*!
+Bucketized cuckoo hash table. Every key can live in one of two buckets of
+CUCKOO_BUCKET_SLOTS slots, one picked by each hash function, or in a small
+stash. A find looks at those two buckets and at the stash when it isn't
+empty, so it costs the same however full the table is. Inserts make room by
+moving items to their other bucket.
+
+Each bucket starts on a cache line, with its keys and hashes first. Keys
+shorter than CUCKOO_INLINE_KEY bytes are stored in the bucket, so with those
+and a T of 4 bytes or less a find touches at most two cache lines. Longer
+keys live in the key arena, and a hit reads the key from there too (a
+miss is nearly always turned away by the hash). With a larger T a bucket
+spans more than one line, but the part a find scans is still the first.
+
+The hash functions are asked for a full hash (by passing the largest table
+size) and the table reduces it, like the PRIME_FASTMOD and POWER_OF_TWO
+sizing policies of OAHashTable. Same exceptions and stats as OAHashTable,
+with Probes_ counting buckets looked at.
+*/
+template <typename T>
+class CuckooHashTable
+{
+public:
+    typedef void (*FREEPROC)(T); //!< client-provided free proc (we own the data)
+
+    //! Configuration for the hash table
+    struct OAHTConfig
+    {
+        //! Non-default constructor
+        OAHTConfig(
+            unsigned InitialTableSize,
+            HASHFUNC PrimaryHashFunc,
+            HASHFUNC SecondaryHashFunc = 0,
+            double MaxLoadFactor = 0.9,
+            FREEPROC FreeProc = 0)
+            : InitialTableSize_(InitialTableSize), PrimaryHashFunc_(PrimaryHashFunc),
+              SecondaryHashFunc_(SecondaryHashFunc), MaxLoadFactor_(MaxLoadFactor),
+              FreeProc_(FreeProc)
+        {
+        }
+
+        unsigned InitialTableSize_;  //!< The starting number of slots
+        HASHFUNC PrimaryHashFunc_;   //!< Picks the first bucket
+        HASHFUNC SecondaryHashFunc_; //!< Picks the second bucket (0: rehash the first)
+        double MaxLoadFactor_;       //!< Maximum LF before doubling
+        FREEPROC FreeProc_;          //!< Client-provided free function
+    };
+
+    CuckooHashTable(const OAHTConfig& Config); // Constructor
+    ~CuckooHashTable();                        // Destructor
+
+    // Insert a key/data pair into table. Throws an exception if the
+    // insertion is unsuccessful.
+    void insert(const char* Key, const T& Data);
+
+    // Delete an item by key. Throws an exception if the key doesn't exist.
+    void remove(const char* Key);
+
+    // Find and return data by key. Throws an exception (E_ITEM_NOT_FOUND)
+    // if not found.
+    const T& find(const char* Key) const;
+
+    // Removes all items from the table (Doesn't deallocate table)
+    void clear();
+
+    // Allow the client to peer into the data
+    OAHTStats GetStats() const;
+
+    // Number of items in the stash (items neither bucket had room for)
+    unsigned GetStashCount() const;
+
+private:
+    // Not copyable
+    CuckooHashTable(const CuckooHashTable&);
+    CuckooHashTable& operator=(const CuckooHashTable&);
+
+    /*!
+    A key as the table holds it: the bytes of a short key, zero padded, or
+    the arena offset of a longer one. The last byte tells them apart (0 for
+    a short key, 0xff for an offset).
+    */
+    typedef unsigned long long KeyWord;
+
+    //! An item on its way into a bucket, or in the stash
+    struct Entry
+    {
+        unsigned Hash; //!< Mixed primary hash of the key
+        KeyWord Key;   //!< The key, or where it is in the key arena
+        T Data;        //!< Client data
+    };
+
+    //! The slots of a bucket, kept together and lined up with a cache line
+    struct alignas(64) Bucket
+    {
+        KeyWord Keys[CUCKOO_BUCKET_SLOTS];    //!< Each key, or EMPTY
+        unsigned Hashes[CUCKOO_BUCKET_SLOTS]; //!< Mixed primary hash of each key
+        T Data[CUCKOO_BUCKET_SLOTS];          //!< Client data
+    };
+
+    //! Bucket::Keys value of an unused slot
+    static const KeyWord EMPTY = ~0ULL;
+
+    // Returns the KeyWord of a short key (Length < CUCKOO_INLINE_KEY)
+    static KeyWord InlineKey(const char* Key, unsigned Length);
+
+    // Returns the KeyWord of a key at Offset in the arena
+    static KeyWord ArenaKey(unsigned Offset);
+
+    // Returns the arena offset of a key that isn't inline, or ~0u if it is
+    static unsigned ArenaOffset(KeyWord Word);
+
+    // Returns the bytes of the key Word holds
+    const char* KeyText(const KeyWord& Word) const;
+
+    // Makes the KeyWord for a new key, copying it to the arena if it's long
+    KeyWord StoreKey(const char* Key);
+
+    // Counts the arena bytes of a removed item's key as dead
+    void ReleaseKey(KeyWord Word);
+
+    // Allocates Count empty buckets, aligned to a cache line
+    void AllocateBuckets(unsigned Count);
+
+    // Destroys and frees the buckets
+    void FreeBuckets();
+
+    // Returns the mixed primary hash of Key
+    unsigned HashOf(const char* Key) const;
+
+    // Returns the index of the first bucket for a key with this hash
+    unsigned FirstBucket(unsigned Hash) const;
+
+    // Returns the index of the second bucket of Key, whose hash is Hash
+    unsigned SecondBucket(const char* Key, unsigned Hash) const;
+
+    // Finds Key. Sets Where to its bucket (or 0 if it's in the stash) and
+    // returns its slot (or stash index), or -1 if it isn't in the table.
+    int Locate(const char* Key, Bucket*& Where) const;
+
+    // Puts Item into a free slot of Index. Returns false if it's full.
+    bool AddToBucket(unsigned Index, const Entry& Item);
+
+    // Places Item in one of its buckets, moving others around as needed,
+    // and in the stash as a last resort. Returns false if the stash is
+    // full too, in which case Item holds an item that still needs a place.
+    bool Place(Entry& Item);
+
+    // Rebuilds the table with Count buckets (and Extra, if not 0),
+    // doubling Count until everything fits
+    void Resize(unsigned Count, const Entry* Extra);
+
+    // Rewrites the key arena so that only keys of items in the table remain
+    void CompactKeys();
+
+    OAHTConfig Config_;
+    mutable OAHTStats Stats_;
+
+    char* BucketMemory_;   //!< What was allocated for the buckets
+    Bucket* Buckets_;      //!< The buckets, aligned within BucketMemory_
+    unsigned BucketCount_; //!< Number of buckets (a power of two)
+    unsigned Random_;      //!< State for picking which item to move
+
+    Entry Stash_[CUCKOO_STASH_SIZE]; //!< Items that didn't fit in their buckets
+    unsigned StashCount_;            //!< Number of items in the stash
+
+    char* Keys_;            //!< Append-only arena holding the long keys' bytes
+    unsigned KeysUsed_;     //!< Bytes of the arena in use (live or not)
+    unsigned KeysCapacity_; //!< Allocated size of the arena
+    unsigned KeysDead_;     //!< Bytes in use by keys that were removed
+};
+
+#include "CuckooHashTable.cpp"
+
+#endif
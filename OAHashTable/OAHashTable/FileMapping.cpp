@@ -0,0 +1,155 @@
+#include "FileMapping.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileMapping::FileMapping()
+    : Data_(0), Size_(0)
+#if defined(_WIN32)
+      ,
+      File_(0), Mapping_(0)
+#endif
+{
+}
+
+FileMapping::~FileMapping()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+bool FileMapping::Open(const char* Path)
+{
+    Close();
+
+    HANDLE file = CreateFileA(
+        Path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    Data_ = static_cast<const char*>(data);
+    Size_ = static_cast<std::size_t>(size.QuadPart);
+    File_ = file;
+    Mapping_ = mapping;
+    return true;
+}
+
+void FileMapping::Close()
+{
+    if (Data_)
+    {
+        UnmapViewOfFile(Data_);
+        CloseHandle(Mapping_);
+        CloseHandle(File_);
+    }
+    Data_ = 0;
+    Size_ = 0;
+    File_ = 0;
+    Mapping_ = 0;
+}
+
+#else
+
+bool FileMapping::Open(const char* Path)
+{
+    Close();
+
+    int file = open(Path, O_RDONLY);
+    if (file == -1)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) == -1 || info.st_size <= 0)
+    {
+        close(file);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(info.st_size);
+    void* data = mmap(0, size, PROT_READ, MAP_SHARED, file, 0);
+
+    // The mapping keeps its own reference to the file
+    close(file);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Data_ = static_cast<const char*>(data);
+    Size_ = size;
+    return true;
+}
+
+void FileMapping::Close()
+{
+    if (Data_)
+    {
+        munmap(const_cast<char*>(Data_), Size_);
+    }
+    Data_ = 0;
+    Size_ = 0;
+}
+
+#endif
+
+void FileMapping::Swap(FileMapping& Other)
+{
+    const char* data = Data_;
+    std::size_t size = Size_;
+    Data_ = Other.Data_;
+    Size_ = Other.Size_;
+    Other.Data_ = data;
+    Other.Size_ = size;
+#if defined(_WIN32)
+    void* file = File_;
+    void* mapping = Mapping_;
+    File_ = Other.File_;
+    Mapping_ = Other.Mapping_;
+    Other.File_ = file;
+    Other.Mapping_ = mapping;
+#endif
+}
+
+const char* FileMapping::GetData() const
+{
+    return Data_;
+}
+
+std::size_t FileMapping::GetSize() const
+{
+    return Size_;
+}
@@ -0,0 +1,47 @@
+//---------------------------------------------------------------------------
+#ifndef FILEMAPPINGH
+#define FILEMAPPINGH
+//---------------------------------------------------------------------------
+#include <cstddef>
+
+/*!
+Read-only view of a whole file, mapped into memory (mmap on POSIX,
+MapViewOfFile on Windows). Pages are read in when they are first touched,
+so opening even a very large file is immediate.
+*/
+class FileMapping
+{
+public:
+    FileMapping();
+    ~FileMapping();
+
+    // Maps the file at Path, unmapping any previous file first. Returns
+    // false if the file can't be opened or mapped (or is empty).
+    bool Open(const char* Path);
+
+    // Unmaps the file (if any)
+    void Close();
+
+    // Exchanges the mapped files of two mappings
+    void Swap(FileMapping& Other);
+
+    // The first byte of the file, or 0 if nothing is mapped
+    const char* GetData() const;
+
+    // Size of the file in bytes
+    std::size_t GetSize() const;
+
+private:
+    // Not copyable
+    FileMapping(const FileMapping&);
+    FileMapping& operator=(const FileMapping&);
+
+    const char* Data_; //!< Start of the mapped file
+    std::size_t Size_; //!< Size of the mapped file
+#if defined(_WIN32)
+    void* File_;       //!< Handle of the open file
+    void* Mapping_;    //!< Handle of the file mapping object
+#endif
+};
+
+#endif
@@ -0,0 +1,483 @@
+#include "HashFuncs.h"
+#include <cstdlib>
+#include <cstring>
+
+unsigned ConstantHash(const char*, unsigned)
+{
+    return 1;
+}
+
+unsigned ReflexiveHash(const char* Key, unsigned TableSize)
+{
+    return static_cast<unsigned>(atoi(Key)) % TableSize;
+}
+
+unsigned PJWHash(const char* Key, unsigned TableSize)
+{
+    // Initial value of hash
+    unsigned hash = 0;
+
+    // Process each char in the string
+    while (*Key)
+    {
+        // Shift hash left 4
+        hash = (hash << 4);
+
+        // Add in current char
+        hash = hash + static_cast<unsigned>((*Key));
+
+        // Get the four high-order bits
+        unsigned bits = hash & 0xF0000000;
+
+        // If any of the four bits are non-zero,
+        if (bits)
+        {
+            // Shift the four bits right 24 positions (...bbbb0000)
+            // and XOR them back in to the hash
+            hash = hash ^ (bits >> 24);
+
+            // Now, XOR the four bits back in
+            hash = hash ^ bits;
+        }
+
+        // Next char
+        Key++;
+    }
+
+    // Modulo so hash is within 0 - TableSize
+    return hash % TableSize;
+}
+
+unsigned SimpleHash(const char* Key, unsigned TableSize)
+{
+    // Initial value of hash
+    unsigned hash = 0;
+
+    // Process each char in the string
+    while (*Key)
+    {
+        // Add in current char
+        hash += static_cast<unsigned>(*Key);
+
+        // Next char
+        Key++;
+    }
+
+    // Modulo so hash is within the table
+    return hash % TableSize;
+}
+
+unsigned RSHash(const char* Key, unsigned TableSize)
+{
+    unsigned hash = 0;         // Initial value of hash
+    unsigned multiplier = 127; // Prevent anomalies
+
+    // Process each char in the string
+    while (*Key)
+    {
+        // Adjust hash total
+        hash = hash * multiplier;
+
+        // Add in current char and mod result
+        hash = (hash + static_cast<unsigned>(*Key)) % TableSize;
+
+        // Next char
+        Key++;
+    }
+
+    // Hash is within 0 - TableSize
+    return hash;
+}
+
+unsigned UHash(const char* Key, unsigned TableSize)
+{
+    unsigned hash = 0;      // Initial value of hash
+    unsigned rand1 = 31415; // "Random" 1
+    unsigned rand2 = 27183; // "Random" 2
+
+    // Process each char in string
+    while (*Key)
+    {
+        // Multiply hash by random
+        hash = hash * rand1;
+
+        // Add in current char, keep within TableSize
+        hash = (hash + static_cast<unsigned>(*Key)) % TableSize;
+
+        // Update rand1 for next "random" number
+        rand1 = (rand1 * rand2) % (TableSize - 1);
+
+        // Next char
+        Key++;
+    }
+    // Hash value is within 0 - TableSize - 1
+    return hash;
+}
+
+namespace
+{
+// wyhash's default secret
+const unsigned long long WySecret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL};
+
+// xxHash64's primes
+const unsigned long long XXPrime1 = 11400714785074694791ULL;
+const unsigned long long XXPrime2 = 14029467366897019727ULL;
+const unsigned long long XXPrime3 = 1609587929392839161ULL;
+const unsigned long long XXPrime4 = 9650029242287828579ULL;
+const unsigned long long XXPrime5 = 2870177450012600261ULL;
+
+// Unaligned reads (memcpy compiles down to a single load)
+inline unsigned long long Read64(const unsigned char* Bytes)
+{
+    unsigned long long value;
+    std::memcpy(&value, Bytes, sizeof(value));
+    return value;
+}
+
+inline unsigned long long Read32(const unsigned char* Bytes)
+{
+    unsigned value;
+    std::memcpy(&value, Bytes, sizeof(value));
+    return value;
+}
+
+// Reads 1 to 3 bytes without going past the end of the key
+inline unsigned long long Read3(const unsigned char* Bytes, std::size_t Length)
+{
+    return (static_cast<unsigned long long>(Bytes[0]) << 16) |
+           (static_cast<unsigned long long>(Bytes[Length >> 1]) << 8) | Bytes[Length - 1];
+}
+
+inline unsigned long long Rotate(unsigned long long Value, int Bits)
+{
+    return (Value << Bits) | (Value >> (64 - Bits));
+}
+
+// Multiplies A and B into a 128-bit product, low half in A, high half in B
+inline void Multiply128(unsigned long long& A, unsigned long long& B)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 product = static_cast<uint128>(A) * B;
+    A = static_cast<unsigned long long>(product);
+    B = static_cast<unsigned long long>(product >> 64);
+#else
+    unsigned long long aHigh = A >> 32, aLow = A & 0xffffffffULL;
+    unsigned long long bHigh = B >> 32, bLow = B & 0xffffffffULL;
+    unsigned long long high = aHigh * bHigh, middle0 = aHigh * bLow;
+    unsigned long long middle1 = aLow * bHigh, low = aLow * bLow;
+    unsigned long long temp = low + (middle0 << 32);
+    unsigned long long carry = temp < low;
+    unsigned long long lowResult = temp + (middle1 << 32);
+    carry += lowResult < temp;
+    A = lowResult;
+    B = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+}
+
+inline unsigned long long WyMix(unsigned long long A, unsigned long long B)
+{
+    Multiply128(A, B);
+    return A ^ B;
+}
+
+inline unsigned long long WySeed(unsigned long long Seed)
+{
+    return Seed ^ WyMix(Seed ^ WySecret[0], WySecret[1]);
+}
+
+// Loads the last 16 bytes of the key into A and B, folding anything
+// before them into Seed
+inline void WyRead(
+    const unsigned char* Bytes,
+    std::size_t Length,
+    unsigned long long& Seed,
+    unsigned long long& A,
+    unsigned long long& B)
+{
+    unsigned long long a = 0;
+    unsigned long long b = 0;
+    if (Length <= 16)
+    {
+        // Two overlapping reads cover 4 to 16 bytes
+        if (Length >= 4)
+        {
+            std::size_t offset = (Length >> 3) << 2;
+            a = (Read32(Bytes) << 32) | Read32(Bytes + offset);
+            b = (Read32(Bytes + Length - 4) << 32) | Read32(Bytes + Length - 4 - offset);
+        }
+        else if (Length > 0)
+        {
+            a = Read3(Bytes, Length);
+        }
+    }
+    else
+    {
+        std::size_t remaining = Length;
+        if (remaining > 48)
+        {
+            // Three independent lanes of 16 bytes each
+            unsigned long long seed1 = Seed;
+            unsigned long long seed2 = Seed;
+            do
+            {
+                Seed = WyMix(Read64(Bytes) ^ WySecret[1], Read64(Bytes + 8) ^ Seed);
+                seed1 = WyMix(Read64(Bytes + 16) ^ WySecret[2], Read64(Bytes + 24) ^ seed1);
+                seed2 = WyMix(Read64(Bytes + 32) ^ WySecret[3], Read64(Bytes + 40) ^ seed2);
+                Bytes += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            Seed ^= seed1 ^ seed2;
+        }
+
+        while (remaining > 16)
+        {
+            Seed = WyMix(Read64(Bytes) ^ WySecret[1], Read64(Bytes + 8) ^ Seed);
+            Bytes += 16;
+            remaining -= 16;
+        }
+
+        // The last 16 bytes (may overlap what was already mixed)
+        a = Read64(Bytes + remaining - 16);
+        b = Read64(Bytes + remaining - 8);
+    }
+    A = a;
+    B = b;
+}
+
+inline unsigned long long WyFinish(
+    unsigned long long A,
+    unsigned long long B,
+    unsigned long long Seed,
+    std::size_t Length)
+{
+    A ^= WySecret[1];
+    B ^= Seed;
+    Multiply128(A, B);
+    return WyMix(A ^ WySecret[0] ^ Length, B ^ WySecret[1]);
+}
+
+inline unsigned long long WyHashBytes(
+    const unsigned char* Bytes,
+    std::size_t Length,
+    unsigned long long Seed)
+{
+    unsigned long long a, b;
+    Seed = WySeed(Seed);
+    WyRead(Bytes, Length, Seed, a, b);
+    return WyFinish(a, b, Seed, Length);
+}
+
+inline unsigned long long XXRound(unsigned long long Accumulator, unsigned long long Input)
+{
+    Accumulator += Input * XXPrime2;
+    Accumulator = Rotate(Accumulator, 31);
+    return Accumulator * XXPrime1;
+}
+
+inline unsigned long long XXMerge(unsigned long long Accumulator, unsigned long long Value)
+{
+    Accumulator ^= XXRound(0, Value);
+    return Accumulator * XXPrime1 + XXPrime4;
+}
+
+// Runs the 32-byte stripes (if any), leaving Bytes at the tail
+inline unsigned long long XXStart(
+    const unsigned char*& Bytes,
+    std::size_t Length,
+    unsigned long long Seed)
+{
+    const unsigned char* end = Bytes + Length;
+    unsigned long long hash;
+
+    if (Length >= 32)
+    {
+        // Four independent lanes of 8 bytes each
+        unsigned long long v1 = Seed + XXPrime1 + XXPrime2;
+        unsigned long long v2 = Seed + XXPrime2;
+        unsigned long long v3 = Seed;
+        unsigned long long v4 = Seed - XXPrime1;
+        do
+        {
+            v1 = XXRound(v1, Read64(Bytes));
+            v2 = XXRound(v2, Read64(Bytes + 8));
+            v3 = XXRound(v3, Read64(Bytes + 16));
+            v4 = XXRound(v4, Read64(Bytes + 24));
+            Bytes += 32;
+        } while (Bytes + 32 <= end);
+
+        hash = Rotate(v1, 1) + Rotate(v2, 7) + Rotate(v3, 12) + Rotate(v4, 18);
+        hash = XXMerge(hash, v1);
+        hash = XXMerge(hash, v2);
+        hash = XXMerge(hash, v3);
+        hash = XXMerge(hash, v4);
+    }
+    else
+    {
+        hash = Seed + XXPrime5;
+    }
+    return hash + Length;
+}
+
+inline unsigned long long XXStep8(unsigned long long Hash, const unsigned char* Bytes)
+{
+    Hash ^= XXRound(0, Read64(Bytes));
+    return Rotate(Hash, 27) * XXPrime1 + XXPrime4;
+}
+
+// The last 0 to 7 bytes, then the final avalanche
+inline unsigned long long XXFinish(
+    unsigned long long Hash,
+    const unsigned char* Bytes,
+    const unsigned char* End)
+{
+    const unsigned char* end = End;
+    unsigned long long hash = Hash;
+    if (Bytes + 4 <= end)
+    {
+        hash ^= Read32(Bytes) * XXPrime1;
+        hash = Rotate(hash, 23) * XXPrime2 + XXPrime3;
+        Bytes += 4;
+    }
+
+    while (Bytes < end)
+    {
+        hash ^= *Bytes * XXPrime5;
+        hash = Rotate(hash, 11) * XXPrime1;
+        Bytes++;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= XXPrime2;
+    hash ^= hash >> 29;
+    hash *= XXPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+inline unsigned long long XXHashBytes(
+    const unsigned char* Bytes,
+    std::size_t Length,
+    unsigned long long Seed)
+{
+    const unsigned char* end = Bytes + Length;
+    unsigned long long hash = XXStart(Bytes, Length, Seed);
+    while (Bytes + 8 <= end)
+    {
+        hash = XXStep8(hash, Bytes);
+        Bytes += 8;
+    }
+    return XXFinish(hash, Bytes, end);
+}
+
+// Keys hashed side by side by the batch functions. Each key's hash is one
+// long chain of multiplies, so running a few chains in lockstep keeps the
+// multiplier busy instead of waiting on one chain at a time.
+const std::size_t BATCH_LANES = 4;
+} // namespace
+
+unsigned long long WyHash64(const void* Key, std::size_t Length, unsigned long long Seed)
+{
+    return WyHashBytes(static_cast<const unsigned char*>(Key), Length, Seed);
+}
+
+unsigned long long XXHash64(const void* Key, std::size_t Length, unsigned long long Seed)
+{
+    return XXHashBytes(static_cast<const unsigned char*>(Key), Length, Seed);
+}
+
+unsigned WyHash(const char* Key, unsigned TableSize)
+{
+    unsigned long long hash =
+        WyHashBytes(reinterpret_cast<const unsigned char*>(Key), std::strlen(Key), 0);
+    return static_cast<unsigned>(hash % TableSize);
+}
+
+unsigned XXHash(const char* Key, unsigned TableSize)
+{
+    unsigned long long hash =
+        XXHashBytes(reinterpret_cast<const unsigned char*>(Key), std::strlen(Key), 0);
+    return static_cast<unsigned>(hash % TableSize);
+}
+
+void WyHashBatch(const char* const* Keys, std::size_t Count, unsigned TableSize, unsigned* Indices)
+{
+    // Same result as calling WyHash on each key. The seed is the same for
+    // every key, so its mix is done once.
+    const unsigned long long seed = WySeed(0);
+    std::size_t i = 0;
+    for (; i + BATCH_LANES <= Count; i += BATCH_LANES)
+    {
+        std::size_t lengths[BATCH_LANES];
+        unsigned long long seeds[BATCH_LANES], a[BATCH_LANES], b[BATCH_LANES];
+        for (std::size_t j = 0; j < BATCH_LANES; j++)
+        {
+            lengths[j] = std::strlen(Keys[i + j]);
+            seeds[j] = seed;
+            WyRead(reinterpret_cast<const unsigned char*>(Keys[i + j]), lengths[j], seeds[j], a[j], b[j]);
+        }
+        for (std::size_t j = 0; j < BATCH_LANES; j++)
+        {
+            unsigned long long hash = WyFinish(a[j], b[j], seeds[j], lengths[j]);
+            Indices[i + j] = static_cast<unsigned>(hash % TableSize);
+        }
+    }
+
+    for (; i < Count; i++)
+    {
+        std::size_t length = std::strlen(Keys[i]);
+        unsigned long long s = seed, a, b;
+        WyRead(reinterpret_cast<const unsigned char*>(Keys[i]), length, s, a, b);
+        Indices[i] = static_cast<unsigned>(WyFinish(a, b, s, length) % TableSize);
+    }
+}
+
+void XXHashBatch(const char* const* Keys, std::size_t Count, unsigned TableSize, unsigned* Indices)
+{
+    // Same result as calling XXHash on each key. The 8-byte steps of the
+    // lanes are run in lockstep until every lane has fewer than 8 left.
+    std::size_t i = 0;
+    for (; i + BATCH_LANES <= Count; i += BATCH_LANES)
+    {
+        const unsigned char* bytes[BATCH_LANES];
+        const unsigned char* ends[BATCH_LANES];
+        unsigned long long hashes[BATCH_LANES];
+        for (std::size_t j = 0; j < BATCH_LANES; j++)
+        {
+            std::size_t length = std::strlen(Keys[i + j]);
+            bytes[j] = reinterpret_cast<const unsigned char*>(Keys[i + j]);
+            ends[j] = bytes[j] + length;
+            hashes[j] = XXStart(bytes[j], length, 0);
+        }
+
+        bool more = true;
+        while (more)
+        {
+            more = false;
+            for (std::size_t j = 0; j < BATCH_LANES; j++)
+            {
+                if (bytes[j] + 8 <= ends[j])
+                {
+                    hashes[j] = XXStep8(hashes[j], bytes[j]);
+                    bytes[j] += 8;
+                    more = true;
+                }
+            }
+        }
+
+        for (std::size_t j = 0; j < BATCH_LANES; j++)
+        {
+            unsigned long long hash = XXFinish(hashes[j], bytes[j], ends[j]);
+            Indices[i + j] = static_cast<unsigned>(hash % TableSize);
+        }
+    }
+
+    for (; i < Count; i++)
+    {
+        const unsigned char* key = reinterpret_cast<const unsigned char*>(Keys[i]);
+        unsigned long long hash = XXHashBytes(key, std::strlen(Keys[i]), 0);
+        Indices[i] = static_cast<unsigned>(hash % TableSize);
+    }
+}
@@ -0,0 +1,38 @@
+//---------------------------------------------------------------------------
+#ifndef HASHFUNCSH
+#define HASHFUNCSH
+//---------------------------------------------------------------------------
+#include <cstddef>
+
+/*
+  Hash functions for the hash tables. Everything that takes a key and a
+  table size has the HASHFUNC signature, so it can be handed straight to
+  OAHTConfig.
+*/
+
+// Classic one-byte-at-a-time hashes
+unsigned ConstantHash(const char* Key, unsigned TableSize);
+unsigned ReflexiveHash(const char* Key, unsigned TableSize);
+unsigned SimpleHash(const char* Key, unsigned TableSize);
+unsigned PJWHash(const char* Key, unsigned TableSize);
+unsigned RSHash(const char* Key, unsigned TableSize);
+unsigned UHash(const char* Key, unsigned TableSize);
+
+/*
+  Fast hashes. These read the key 8 bytes at a time and only reduce to
+  the table size once, at the end. WyHash64 follows wyhash (multiply and
+  fold the 128-bit product), XXHash64 follows xxHash64 (four independent
+  rotate/multiply lanes).
+*/
+unsigned long long WyHash64(const void* Key, std::size_t Length, unsigned long long Seed = 0);
+unsigned long long XXHash64(const void* Key, std::size_t Length, unsigned long long Seed = 0);
+
+// The fast hashes with the HASHFUNC signature
+unsigned WyHash(const char* Key, unsigned TableSize);
+unsigned XXHash(const char* Key, unsigned TableSize);
+
+// Hash Count keys in one call, storing each key's index into Indices
+void WyHashBatch(const char* const* Keys, std::size_t Count, unsigned TableSize, unsigned* Indices);
+void XXHashBatch(const char* const* Keys, std::size_t Count, unsigned TableSize, unsigned* Indices);
+
+#endif
@@ -1,136 +1,1355 @@
 #include "OAHashTable.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 
-struct OAHTSlot;
+/*
+  Runs Func(Part, First, Last) for Parts contiguous parts of [0, Count),
+  each part on its own thread (the first one on the calling thread).
+  Returns when every part is done.
+*/
+template <typename F>
+void OAHTParallel(unsigned Parts, size_t Count, F Func)
+{
+    std::vector<std::thread> threads;
+    for (unsigned part = 1; part < Parts; part++)
+    {
+        size_t first = Count * part / Parts;
+        size_t last = Count * (part + 1) / Parts;
+        try
+        {
+            threads.push_back(std::thread(Func, part, first, last));
+        }
+        catch (std::system_error&)
+        {
+            // Out of threads, so this one does the work
+            Func(part, first, last);
+        }
+    }
 
-template <class T>
-OAHashTable<T>::OAHashTable(const OAHTConfig& Config) : Config_(Config)
+    Func(0u, size_t(0), Count / Parts);
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+}
+
+/*
+  Copies Length bytes of Key (plus a terminator) to the end of the key arena
+  Keys, which holds Used of its Capacity bytes, and returns the offset of
+  the copy. The arena doubles when it's full. Key may point into the arena.
+*/
+inline unsigned OAHTAppendKey(
+    char*& Keys,
+    unsigned& Used,
+    unsigned& Capacity,
+    const char* Key,
+    unsigned Length)
 {
+    unsigned needed = Length + 1;
+    if (needed == 0 || needed > ~0u - Used)
+    {
+        throw OAHashTableException(OAHashTableException::E_NO_MEMORY, "Key arena is full");
+    }
+
+    if (Used + needed > Capacity)
+    {
+        unsigned capacity = Capacity > ~0u / 2 ? ~0u : Capacity * 2;
+        if (capacity < Used + needed)
+        {
+            capacity = Used + needed;
+        }
+
+        char* keys = nullptr;
+        try
+        {
+            keys = new char[capacity];
+        }
+        catch (std::bad_alloc&)
+        {
+            throw OAHashTableException(
+                OAHashTableException::E_NO_MEMORY, "Out of memory growing the key arena");
+        }
+
+        // Key may live in the old arena, so copy it before freeing that
+        std::memcpy(keys, Keys, Used);
+        std::memcpy(keys + Used, Key, Length);
+        delete[] Keys;
+        Keys = keys;
+        Capacity = capacity;
+    }
+    else
+    {
+        std::memmove(Keys + Used, Key, Length);
+    }
+
+    unsigned offset = Used;
+    Keys[offset + Length] = 0;
+    Used += needed;
+    return offset;
 }
 
-template <class T>
-OAHashTable<T>::~OAHashTable()
+/*
+  Rewrites the key arena so that only live keys remain. ForEachKey(Move)
+  has to call Move(Offset, Length) for every live key and store the new
+  offset it returns. Nothing changes if the new arena can't be allocated.
+*/
+template <typename F>
+void OAHTCompactKeys(char*& Keys, unsigned& Used, unsigned Capacity, unsigned& Dead, F ForEachKey)
 {
+    char* keys = new (std::nothrow) char[Capacity];
+    if (!keys)
+    {
+        // Not fatal, the dead keys just stick around for now
+        return;
+    }
+
+    unsigned used = 0;
+    ForEachKey([&](unsigned Offset, unsigned Length) {
+        std::memcpy(keys + used, Keys + Offset, Length + 1);
+        unsigned moved = used;
+        used += Length + 1;
+        return moved;
+    });
+
+    delete[] Keys;
+    Keys = keys;
+    Used = used;
+    Dead = 0;
 }
 
-template <class T>
-void OAHashTable<T>::insert(const char* Key, const T& Data)
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+OAHashTable<KeyType, T, Hasher, Eq>::OAHashTable(
+    const OAHTConfig& Config,
+    const Hasher& Primary,
+    const Hasher& Secondary,
+    const Eq& Equal)
+    : Config_(Config), Table_(nullptr), Primary_(Primary), Secondary_(Secondary), Equal_(Equal),
+      Keys_(nullptr), KeysUsed_(0), KeysCapacity_(0), KeysDead_(0)
+{
+    unsigned size = Config_.InitialTableSize_;
+    if (Config_.Sizing_ == POWER_OF_TWO)
+    {
+        size = GetNextPowerOfTwo(size);
+    }
+    SetTableSize(size);
+
+    try
+    {
+        Table_ = new OAHTSlot[Stats_.TableSize_];
+        Keys_ = new char[KEY_ARENA_SIZE];
+    }
+    catch (std::bad_alloc&)
+    {
+        delete[] Table_;
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Out of memory allocating the table");
+    }
+    KeysCapacity_ = KEY_ARENA_SIZE;
+
+    InitTable();
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+OAHashTable<KeyType, T, Hasher, Eq>::OAHashTable(
+    const OAHTConfig& Config,
+    const KeyType* Keys,
+    const T* Data,
+    size_t Count,
+    unsigned Threads,
+    const Hasher& Primary,
+    const Hasher& Secondary,
+    const Eq& Equal)
+    : Config_(Config), Table_(nullptr), Primary_(Primary), Secondary_(Secondary), Equal_(Equal),
+      Keys_(nullptr), KeysUsed_(0), KeysCapacity_(0), KeysDead_(0)
+{
+    if (Count > ~0u)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Too many items for one table");
+    }
+
+    // Go straight to the size inserting the items one at a time would end at
+    unsigned size = Config_.InitialTableSize_;
+    if (Config_.Sizing_ == POWER_OF_TWO)
+    {
+        size = GetNextPowerOfTwo(size);
+    }
+    while (static_cast<double>(Count) / size > Config_.MaxLoadFactor_ || Count > size)
+    {
+        size = NextSize(size);
+    }
+    SetTableSize(size);
+
+    // A few thousand items per thread, so small builds don't pay for threads
+    if (!Threads)
+    {
+        Threads = std::thread::hardware_concurrency();
+    }
+    unsigned parts = static_cast<unsigned>(Count / 4096);
+    parts = parts < Threads ? parts : Threads;
+    parts = parts ? parts : 1;
+
+    // Each part copies its keys to its own stretch of the arena
+    std::vector<size_t> keyOffsets(parts + 1, 0);
+    if (KeyTraits::InArena)
+    {
+        OAHTParallel(parts, Count, [&](unsigned Part, size_t First, size_t Last) {
+            size_t bytes = 0;
+            for (size_t i = First; i < Last; i++)
+            {
+                bytes += KeyTraits::Length(Keys[i]) + 1;
+            }
+            keyOffsets[Part + 1] = bytes;
+        });
+    }
+    for (unsigned part = 0; part < parts; part++)
+    {
+        keyOffsets[part + 1] += keyOffsets[part];
+    }
+    if (keyOffsets[parts] > ~0u)
+    {
+        throw OAHashTableException(OAHashTableException::E_NO_MEMORY, "Key arena is full");
+    }
+    unsigned keysSize = static_cast<unsigned>(keyOffsets[parts]);
+
+    // Slots are claimed with these, so threads never write the same slot.
+    // A READY slot is completely written and can be compared against.
+    enum
+    {
+        FREE,
+        CLAIMED,
+        READY
+    };
+    std::atomic<unsigned char>* claims = nullptr;
+    try
+    {
+        Table_ = new OAHTSlot[size];
+        KeysCapacity_ = keysSize > KEY_ARENA_SIZE ? keysSize : KEY_ARENA_SIZE;
+        Keys_ = new char[KeysCapacity_];
+        claims = new std::atomic<unsigned char>[size]();
+    }
+    catch (std::bad_alloc&)
+    {
+        delete[] Table_;
+        delete[] Keys_;
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Out of memory allocating the table");
+    }
+
+    std::vector<unsigned> probes(parts, 0);
+    std::vector<OAHTProfile> profiles(parts);
+    std::atomic<bool> duplicate(false);
+    std::atomic<bool> stuck(false);
+    OAHTParallel(parts, Count, [&](unsigned Part, size_t First, size_t Last) {
+        unsigned offset = static_cast<unsigned>(keyOffsets[Part]);
+        for (size_t i = First; i < Last; i++)
+        {
+            const KeyType& key = Keys[i];
+            unsigned length = 0;
+            if (KeyTraits::InArena)
+            {
+                length = KeyTraits::Length(key);
+                std::memcpy(Keys_ + offset, KeyTraits::Bytes(key), length);
+                Keys_[offset + length] = 0;
+            }
+
+            unsigned hash = HashOf(key);
+            unsigned stride = StrideOf(key);
+            unsigned index = HomeOf(hash);
+            unsigned count = 1;
+            for (;; count++)
+            {
+                // More probes than slots means the probe sequence is going
+                // around a cycle with no free slot in it (a stride sharing a
+                // factor with the table size, or a full table)
+                if (count > size)
+                {
+                    stuck = true;
+                    break;
+                }
+
+                unsigned char state = claims[index].load(std::memory_order_acquire);
+                if (state == FREE)
+                {
+                    if (claims[index].compare_exchange_strong(state, CLAIMED))
+                    {
+                        OAHTSlot& slot = Table_[index];
+                        slot.Key = KeyTraits::Store(key, offset);
+                        slot.Hash = hash;
+                        slot.Data = Data[i];
+                        slot.probes = static_cast<int>(count);
+                        claims[index].store(READY, std::memory_order_release);
+                        RecordProbes(profiles[Part].Inserts_, count);
+                        break;
+                    }
+                }
+
+                // Someone else got here first, wait until they're done
+                while (state == CLAIMED)
+                {
+                    std::this_thread::yield();
+                    state = claims[index].load(std::memory_order_acquire);
+                }
+
+                const OAHTSlot& slot = Table_[index];
+                if (slot.Hash == hash && Equal_(KeyTraits::Load(Keys_, slot.Key), key))
+                {
+                    duplicate = true;
+                    break;
+                }
+                index = NextIndex(index, stride);
+            }
+
+            probes[Part] += count;
+            offset += KeyTraits::InArena ? length + 1 : 0;
+        }
+    });
+
+    if (duplicate)
+    {
+        delete[] claims;
+        delete[] Table_;
+        delete[] Keys_;
+        throw OAHashTableException(
+            OAHashTableException::E_DUPLICATE, "Item being inserted is a duplicate");
+    }
+
+    // Start over and insert the items one at a time, which grows the table
+    // when a key can't be placed
+    if (stuck)
+    {
+        delete[] claims;
+        InitTable();
+        try
+        {
+            for (size_t i = 0; i < Count; i++)
+            {
+                insert(Keys[i], Data[i]);
+            }
+        }
+        catch (...)
+        {
+            delete[] Table_;
+            delete[] Keys_;
+            throw;
+        }
+        return;
+    }
+
+    OAHTParallel(parts, size, [&](unsigned, size_t First, size_t Last) {
+        for (size_t i = First; i < Last; i++)
+        {
+            Table_[i].State = claims[i] == READY ? OAHTSlot::OCCUPIED : OAHTSlot::UNOCCUPIED;
+        }
+    });
+    delete[] claims;
+
+    for (unsigned part = 0; part < parts; part++)
+    {
+        Stats_.Probes_ += probes[part];
+        for (unsigned i = 0; i < PROBE_HISTOGRAM_SIZE; i++)
+        {
+            Profile_.Inserts_[i] += profiles[part].Inserts_[i];
+        }
+    }
+    Stats_.Count_ = static_cast<unsigned>(Count);
+    KeysUsed_ = keysSize;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+OAHashTable<KeyType, T, Hasher, Eq>::~OAHashTable()
+{
+    // A mapped table's slots and keys belong to the file
+    if (!Mapping_.GetData())
+    {
+        clear();
+        delete[] Table_;
+        delete[] Keys_;
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::insert(const KeyType& Key, const T& Data)
+{
+    CheckWritable();
+
+    // Grow first if this item would push us past the max load factor
+    double loadFactor = static_cast<double>(Stats_.Count_ + 1) / Stats_.TableSize_;
+    if (loadFactor > Config_.MaxLoadFactor_)
+    {
+        GrowTable();
+    }
+
+    InsertAt(Key, HashOf(Key), Data);
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::InsertAt(
+    const KeyType& Key,
+    unsigned HashValue,
+    const T& Data)
 {
     OAHTSlot* slot = nullptr;
-    int index = IndexOf(Key, slot);
-    if (index == -1)
+    unsigned probes = Stats_.Probes_;
+    if (IndexOf(Key, HashValue, slot) != -1)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_DUPLICATE, "Item being inserted is a duplicate");
+    }
+
+    // Every slot in the probe sequence is occupied, so make some room
+    if (!slot)
     {
         GrowTable();
-        index = IndexOf(Key, slot);
+        HashValue = HashOf(Key);
+        IndexOf(Key, HashValue, slot);
     }
-    slot->Key = Key;
+
+    if (slot->State == OAHTSlot::DELETED)
+    {
+        Stats_.Deleted_--;
+    }
+
+    slot->Key = StoreKey(Key);
+    slot->Hash = HashValue;
     slot->Data = Data;
-    slot->State = OAHTSlot::OAHTSlotState::OCCUPIED;
-    Config_.NumOccupiedSlots++;
+    slot->State = OAHTSlot::OCCUPIED;
+    slot->probes = static_cast<int>(Stats_.Probes_ - probes);
+    RecordProbes(Profile_.Inserts_, Stats_.Probes_ - probes);
+    Stats_.Count_++;
 }
 
-template <typename T>
-void OAHashTable<T>::remove(const char* Key)
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::remove(const KeyType& Key)
 {
+    CheckWritable();
+
     OAHTSlot* slot = nullptr;
+    unsigned probes = Stats_.Probes_;
     int index = IndexOf(Key, slot);
-    if (index != -1)
+    if (index == -1)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+    }
+    RecordProbes(Profile_.Removes_, Stats_.Probes_ - probes);
+
+    // Figure out where the rest of the cluster is before Key can go away
+    unsigned stride = StrideOf(Key);
+
+    if (Config_.FreeProc_)
+    {
+        Config_.FreeProc_(slot->Data);
+    }
+    KeysDead_ += KeyTraits::Size(slot->Key);
+    Stats_.Count_--;
+
+    if (Config_.DeletionPolicy_ == MARK)
     {
-        slot->State = OAHTSlot::OAHTSlotState::DELETED;
-        Config_.NumOccupiedSlots--;
+        slot->State = OAHTSlot::DELETED;
+        Stats_.Deleted_++;
+
+        // Too many tombstones make every probe sequence long
+        if (Config_.MaxDeletedFactor_ > 0 &&
+            Stats_.Deleted_ > Config_.MaxDeletedFactor_ * Stats_.TableSize_)
+        {
+            rehash();
+        }
+    }
+    else if (Config_.DoubleHashing_)
+    {
+        // The keys of a cluster probe with their own strides, so there's no
+        // telling which of them went past this slot. Rebuild the table in
+        // place instead of the cluster, which leaves no tombstone.
+        slot->State = OAHTSlot::DELETED;
+        Stats_.Deleted_++;
+        rehash();
+    }
+    else
+    {
+        // Empty the slot, then reinsert everything after it in the cluster (a
+        // stride of 1 always gets as far as the slot just emptied)
+        slot->State = OAHTSlot::UNOCCUPIED;
+        unsigned next = NextIndex(static_cast<unsigned>(index), stride);
+        while (Table_[next].State == OAHTSlot::OCCUPIED)
+        {
+            OAHTSlot moved = Table_[next];
+            Table_[next].State = OAHTSlot::UNOCCUPIED;
+            Reinsert(moved);
+            next = NextIndex(next, stride);
+        }
+    }
+
+    // Don't let the arena fill up with the keys of removed items
+    if (KeysUsed_ >= KEY_ARENA_SIZE && KeysDead_ > KeysUsed_ / 2)
+    {
+        CompactKeys();
     }
 }
 
-template <typename T>
-const T& OAHashTable<T>::find(const char* Key) const
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+const T& OAHashTable<KeyType, T, Hasher, Eq>::find(const KeyType& Key) const
 {
     OAHTSlot* slot = nullptr;
-    int index = IndexOf(Key, slot);
-    if (index != -1)
+    unsigned probes = Stats_.Probes_;
+    if (IndexOf(Key, slot) == -1)
+    {
+        RecordProbes(Profile_.FindMisses_, Stats_.Probes_ - probes);
+        throw OAHashTableException(
+            OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+    }
+    RecordProbes(Profile_.FindHits_, Stats_.Probes_ - probes);
+    return slot->Data;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::find_batch(
+    const KeyType* Keys,
+    size_t Count,
+    const T** Data) const
+{
+    unsigned hashes[PREFETCH_BATCH];
+    for (size_t first = 0; first < Count; first += PREFETCH_BATCH)
+    {
+        size_t last = Count - first < PREFETCH_BATCH ? Count : first + PREFETCH_BATCH;
+
+        // Hash the whole group and start loading each home slot
+        for (size_t i = first; i < last; i++)
+        {
+            hashes[i - first] = HashOf(Keys[i]);
+            OAHTPrefetch(&Table_[HomeOf(hashes[i - first])]);
+        }
+
+        // Then the key bytes of the slots that look like a match
+        for (size_t i = first; i < last; i++)
+        {
+            const OAHTSlot& home = Table_[HomeOf(hashes[i - first])];
+            if (KeyTraits::InArena && home.State == OAHTSlot::OCCUPIED &&
+                home.Hash == hashes[i - first])
+            {
+                OAHTPrefetch(Keys_ + KeyTraits::Offset(home.Key));
+            }
+        }
+
+        // Most of the memory has arrived by the time we probe
+        for (size_t i = first; i < last; i++)
+        {
+            OAHTSlot* slot = nullptr;
+            unsigned probes = Stats_.Probes_;
+            if (IndexOf(Keys[i], hashes[i - first], slot) == -1)
+            {
+                RecordProbes(Profile_.FindMisses_, Stats_.Probes_ - probes);
+                Data[i] = nullptr;
+            }
+            else
+            {
+                RecordProbes(Profile_.FindHits_, Stats_.Probes_ - probes);
+                Data[i] = &slot->Data;
+            }
+        }
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::insert_batch(
+    const KeyType* Keys,
+    const T* Data,
+    size_t Count)
+{
+    CheckWritable();
+
+    // Grow up front, so the table size (and every home slot) holds for the
+    // whole batch. This ends at the same size as inserting one at a time.
+    while (static_cast<double>(Stats_.Count_ + Count) / Stats_.TableSize_ >
+           Config_.MaxLoadFactor_)
     {
-        return slot->Data;
+        GrowTable();
+    }
+
+    unsigned hashes[PREFETCH_BATCH];
+    for (size_t first = 0; first < Count; first += PREFETCH_BATCH)
+    {
+        size_t last = Count - first < PREFETCH_BATCH ? Count : first + PREFETCH_BATCH;
+
+        unsigned size = Stats_.TableSize_;
+        for (size_t i = first; i < last; i++)
+        {
+            hashes[i - first] = HashOf(Keys[i]);
+            OAHTPrefetch(&Table_[HomeOf(hashes[i - first])]);
+        }
+
+        for (size_t i = first; i < last; i++)
+        {
+            // A full probe sequence can still grow the table (MaxLoadFactor > 1)
+            unsigned hash = hashes[i - first];
+            if (Stats_.TableSize_ != size)
+            {
+                hash = HashOf(Keys[i]);
+            }
+            InsertAt(Keys[i], hash, Data[i]);
+        }
     }
-    return nullptr;
 }
 
-template <typename T>
-void OAHashTable<T>::clear()
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::clear()
 {
-    Config_.NumOccupiedSlots = 0;
+    CheckWritable();
+
+    for (unsigned i = 0; i < Stats_.TableSize_; i++)
+    {
+        if (Table_[i].State == OAHTSlot::OCCUPIED && Config_.FreeProc_)
+        {
+            Config_.FreeProc_(Table_[i].Data);
+        }
+    }
     InitTable();
 }
 
-template <typename T>
-OAHTStats OAHashTable<T>::GetStats() const
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::rehash()
+{
+    CheckWritable();
+
+    // Items still waiting to be placed are marked DELETED, and only those
+    // slots and the empty ones are free. Each item goes into the first free
+    // slot of its probe sequence, so every slot it probes past is already
+    // final and finds stay correct. Placing an item over a waiting one swaps
+    // the two, and the waiting one is placed next. A stride that shares a
+    // factor with the table size (which happens when the size isn't prime)
+    // visits only some of the slots, so an item can run out of free ones;
+    // growing the table places everything again.
+    for (unsigned i = 0; i < Stats_.TableSize_; i++)
+    {
+        if (Table_[i].State == OAHTSlot::OCCUPIED)
+        {
+            Table_[i].State = OAHTSlot::DELETED;
+        }
+        else
+        {
+            Table_[i].State = OAHTSlot::UNOCCUPIED;
+        }
+    }
+
+    for (unsigned i = 0; i < Stats_.TableSize_; i++)
+    {
+        while (Table_[i].State == OAHTSlot::DELETED)
+        {
+            unsigned stride = StrideOf(GetKey(Table_[i]));
+            unsigned index = HomeOf(Table_[i].Hash);
+            int probes = 1;
+
+            Stats_.Probes_++;
+            while (Table_[index].State == OAHTSlot::OCCUPIED)
+            {
+                if (static_cast<unsigned>(probes) == Stats_.TableSize_)
+                {
+                    for (unsigned j = 0; j < Stats_.TableSize_; j++)
+                    {
+                        if (Table_[j].State == OAHTSlot::DELETED)
+                        {
+                            Table_[j].State = OAHTSlot::OCCUPIED;
+                        }
+                    }
+                    GrowTable();
+                    return;
+                }
+                index = NextIndex(index, stride);
+                Stats_.Probes_++;
+                probes++;
+            }
+
+            if (index == i)
+            {
+                Table_[i].State = OAHTSlot::OCCUPIED;
+                Table_[i].probes = probes;
+            }
+            else if (Table_[index].State == OAHTSlot::UNOCCUPIED)
+            {
+                Table_[index] = Table_[i];
+                Table_[index].State = OAHTSlot::OCCUPIED;
+                Table_[index].probes = probes;
+                Table_[i].State = OAHTSlot::UNOCCUPIED;
+            }
+            else
+            {
+                OAHTSlot waiting = Table_[index];
+                Table_[index] = Table_[i];
+                Table_[index].State = OAHTSlot::OCCUPIED;
+                Table_[index].probes = probes;
+                Table_[i] = waiting;
+            }
+        }
+    }
+
+    Stats_.Deleted_ = 0;
+    Stats_.Rehashes_++;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+OAHTStats OAHashTable<KeyType, T, Hasher, Eq>::GetStats() const
+{
+    return Stats_;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+OAHTProfile OAHashTable<KeyType, T, Hasher, Eq>::GetProfile() const
+{
+    OAHTProfile profile = Profile_;
+
+    // Start counting right after an empty slot, so a cluster that wraps
+    // around the end of the table is seen as one
+    unsigned size = Stats_.TableSize_;
+    unsigned start = 0;
+    while (start < size && Table_[start].State != OAHTSlot::UNOCCUPIED)
+    {
+        start++;
+    }
+
+    if (start == size)
+    {
+        profile.LongestCluster_ = size;
+        return profile;
+    }
+
+    unsigned length = 0;
+    for (unsigned i = 1; i <= size; i++)
+    {
+        unsigned index = start + i < size ? start + i : start + i - size;
+        if (Table_[index].State == OAHTSlot::UNOCCUPIED)
+        {
+            length = 0;
+        }
+        else if (++length > profile.LongestCluster_)
+        {
+            profile.LongestCluster_ = length;
+        }
+    }
+    return profile;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+const typename OAHashTable<KeyType, T, Hasher, Eq>::OAHTSlot* OAHashTable<KeyType, T, Hasher, Eq>::
+    GetTable() const
+{
+    return Table_;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+KeyType OAHashTable<KeyType, T, Hasher, Eq>::GetKey(const OAHTSlot& Slot) const
+{
+    return KeyTraits::Load(Keys_, Slot.Key);
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+typename OAHashTable<KeyType, T, Hasher, Eq>::const_iterator OAHashTable<KeyType, T, Hasher, Eq>::
+    begin() const
 {
-    OAHTStats stats;
-    stats.NumOccupiedSlots = Config_.NumOccupiedSlots;
-    stats.TableSize = Config_.TableSize;
-    return stats;
+    return const_iterator(Keys_, Table_, Table_ + Stats_.TableSize_);
 }
 
-template <typename T>
-const OAHTSlot* OAHashTable<T>::GetTable() const
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+typename OAHashTable<KeyType, T, Hasher, Eq>::const_iterator OAHashTable<KeyType, T, Hasher, Eq>::
+    end() const
 {
-    return Config_.Table;
+    return const_iterator(Keys_, Table_ + Stats_.TableSize_, Table_ + Stats_.TableSize_);
 }
 
-template <typename T>
-void OAHashTable<T>::InitTable()
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+template <typename F>
+void OAHashTable<KeyType, T, Hasher, Eq>::parallel_for_each(F Func, unsigned Threads) const
 {
-    Config_.NumOccupiedSlots = 0;
-    Config_.TableSize = Config_.InitialTableSize;
-    Config_.Table = new OAHTSlot[Config_.TableSize];
-    for (int i = 0; i < Config_.TableSize; i++)
+    // Like the bulk build, a few thousand slots per thread at least
+    if (!Threads)
     {
-        Config_.Table[i].State = OAHTSlot::OAHTSlotState::EMPTY;
+        Threads = std::thread::hardware_concurrency();
+    }
+    unsigned parts = Stats_.TableSize_ / 4096;
+    parts = parts < Threads ? parts : Threads;
+    parts = parts ? parts : 1;
+
+    // An exception can't leave a thread, so each part keeps its own
+    std::vector<std::exception_ptr> errors(parts);
+    OAHTParallel(parts, Stats_.TableSize_, [&](unsigned Part, size_t First, size_t Last) {
+        try
+        {
+            for (size_t i = First; i < Last; i++)
+            {
+                if (Table_[i].State == OAHTSlot::OCCUPIED)
+                {
+                    Func(GetKey(Table_[i]), static_cast<const T&>(Table_[i].Data));
+                }
+            }
+        }
+        catch (...)
+        {
+            errors[Part] = std::current_exception();
+        }
+    });
+
+    for (unsigned part = 0; part < parts; part++)
+    {
+        if (errors[part])
+        {
+            std::rethrow_exception(errors[part]);
+        }
     }
 }
 
-template <typename T>
-void OAHashTable<T>::GrowTable()
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::save(const char* Path) const
 {
-    OAHTSlot* oldTable = Config_.Table;
-    int oldTableSize = Config_.TableSize;
-    Config_.TableSize = Config_.TableSize * 2;
-    Config_.Table = new OAHTSlot[Config_.TableSize];
-    for (int i = 0; i < Config_.TableSize; i++)
+    static_assert(std::is_trivially_copyable<T>::value, "save needs a trivially copyable T");
+    static_assert(
+        std::is_trivially_copyable<typename KeyTraits::Stored>::value,
+        "save needs a trivially copyable key");
+
+    std::FILE* file = std::fopen(Path, "wb");
+    if (!file)
     {
-        Config_.Table[i].State = OAHTSlot::OAHTSlotState::EMPTY;
+        throw OAHashTableException(
+            OAHashTableException::E_FILE_ERROR, "Can't open the file to save the table to");
     }
-    for (int i = 0; i < oldTableSize; i++)
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic_, "OAHT", 4);
+    header.Version_ = 1;
+    header.ByteOrder_ = 0x01020304;
+    header.SlotSize_ = sizeof(OAHTSlot);
+    header.Sizing_ = Config_.Sizing_;
+    header.TableSize_ = Stats_.TableSize_;
+    header.Count_ = Stats_.Count_;
+    header.Deleted_ = Stats_.Deleted_;
+    for (unsigned i = 0; i < Stats_.TableSize_; i++)
     {
-        if (oldTable[i].State == OAHTSlot::OAHTSlotState::OCCUPIED)
+        if (Table_[i].State == OAHTSlot::OCCUPIED)
         {
-            OAHTSlot* slot = nullptr;
-            int index = IndexOf(oldTable[i].Key, slot);
-            slot->Key = oldTable[i].Key;
-            slot->Data = oldTable[i].Data;
-            slot->State = OAHTSlot::OAHTSlotState::OCCUPIED;
+            header.KeysSize_ += KeyTraits::Size(Table_[i].Key);
         }
     }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // The slots go out a chunk at a time, with the keys renumbered as if
+    // the arena were compacted. Everything else is zeroed (padding too),
+    // so the same table always gives the same file.
+    const unsigned chunkSize = 64;
+    OAHTSlot chunk[chunkSize];
+    unsigned offset = 0;
+    for (unsigned first = 0; first < Stats_.TableSize_ && written; first += chunkSize)
+    {
+        unsigned count = chunkSize;
+        if (Stats_.TableSize_ - first < count)
+        {
+            count = Stats_.TableSize_ - first;
+        }
+        for (unsigned i = 0; i < count; i++)
+        {
+            const OAHTSlot& slot = Table_[first + i];
+            std::memset(static_cast<void*>(&chunk[i]), 0, sizeof(OAHTSlot));
+            chunk[i].State = slot.State;
+            if (slot.State == OAHTSlot::OCCUPIED)
+            {
+                chunk[i].Key = slot.Key;
+                KeyTraits::Move(chunk[i].Key, offset);
+                chunk[i].Hash = slot.Hash;
+                chunk[i].Data = slot.Data;
+                chunk[i].probes = slot.probes;
+                offset += KeyTraits::Size(slot.Key);
+            }
+        }
+        written = std::fwrite(chunk, sizeof(OAHTSlot), count, file) == count;
+    }
+
+    // Then the keys, in the same order
+    for (unsigned i = 0; i < Stats_.TableSize_ && written; i++)
+    {
+        const OAHTSlot& slot = Table_[i];
+        std::size_t length = KeyTraits::Size(slot.Key);
+        if (slot.State == OAHTSlot::OCCUPIED && length)
+        {
+            written = std::fwrite(Keys_ + KeyTraits::Offset(slot.Key), 1, length, file) == length;
+        }
+    }
+
+    if (std::fclose(file) != 0 || !written)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_FILE_ERROR, "Error writing the table to the file");
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::load_mapped(const char* Path)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "load_mapped needs a trivially copyable T");
+
+    FileMapping mapping;
+    if (!mapping.Open(Path))
+    {
+        throw OAHashTableException(OAHashTableException::E_FILE_ERROR, "Can't map the file");
+    }
+
+    const char* data = mapping.GetData();
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+    if (mapping.GetSize() < sizeof(FileHeader) || std::memcmp(header->Magic_, "OAHT", 4) != 0 ||
+        header->Version_ != 1 || header->ByteOrder_ != 0x01020304 ||
+        header->SlotSize_ != sizeof(OAHTSlot) || header->TableSize_ == 0 ||
+        mapping.GetSize() != sizeof(FileHeader) +
+                                 static_cast<std::size_t>(header->TableSize_) * sizeof(OAHTSlot) +
+                                 header->KeysSize_)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_FILE_ERROR, "The file doesn't hold a saved table of this type");
+    }
+
+    if (header->Sizing_ != static_cast<unsigned>(Config_.Sizing_))
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_FILE_ERROR, "The table was saved with another sizing policy");
+    }
+
+    // The file is only read, but the members aren't const
+    OAHTSlot* table = reinterpret_cast<OAHTSlot*>(const_cast<char*>(data + sizeof(FileHeader)));
+    char* keys = reinterpret_cast<char*>(table + header->TableSize_);
+
+    // Every slot has to be sound before anything reads through it: a known
+    // state, and for occupied slots a terminated key inside the arena. The
+    // state is copied out as an integer, since a stray value in the file
+    // isn't a valid OAHTSlot_State.
+    typedef typename std::underlying_type<typename OAHTSlot::OAHTSlot_State>::type StateBits;
+    unsigned occupied = 0;
+    unsigned deleted = 0;
+    bool sound = true;
+    for (unsigned i = 0; i < header->TableSize_ && sound; i++)
+    {
+        const OAHTSlot& slot = table[i];
+        StateBits state;
+        std::memcpy(&state, &slot.State, sizeof(state));
+        if (state == OAHTSlot::OCCUPIED)
+        {
+            occupied++;
+            sound = KeyTraits::Fits(slot.Key, keys, header->KeysSize_);
+        }
+        else if (state == OAHTSlot::DELETED)
+        {
+            deleted++;
+        }
+        else
+        {
+            sound = state == OAHTSlot::UNOCCUPIED;
+        }
+    }
+    if (!sound || occupied != header->Count_ || deleted != header->Deleted_)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_FILE_ERROR, "The file holds a damaged table");
+    }
+
+    // Look up the first few saved keys in the saved slots. This only finds
+    // them if our hash functions put them where the saved table's did.
+    OAHTSlot* oldTable = Table_;
+    char* oldKeys = Keys_;
+    unsigned oldSize = Stats_.TableSize_;
+    Table_ = table;
+    Keys_ = keys;
+    SetTableSize(header->TableSize_);
+
+    bool found = true;
+    unsigned checked = 0;
+    for (unsigned i = 0; i < header->TableSize_ && found && checked < 8; i++)
+    {
+        const OAHTSlot& slot = table[i];
+        if (slot.State == OAHTSlot::OCCUPIED)
+        {
+            KeyType key = GetKey(slot);
+            OAHTSlot* where = nullptr;
+            found = HashOf(key) == slot.Hash && IndexOf(key, where) == static_cast<int>(i);
+            checked++;
+        }
+    }
+
+    Table_ = oldTable;
+    Keys_ = oldKeys;
+    SetTableSize(oldSize);
+    if (!found)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_FILE_ERROR, "The table was saved with other hash functions");
+    }
+
+    // Let go of what we had, and use the file instead
+    if (!Mapping_.GetData())
+    {
+        clear();
+        delete[] Table_;
+        delete[] Keys_;
+    }
+    Mapping_.Swap(mapping);
+
+    Table_ = table;
+    Keys_ = keys;
+    SetTableSize(header->TableSize_);
+    Stats_.Count_ = header->Count_;
+    Stats_.Deleted_ = header->Deleted_;
+    KeysUsed_ = header->KeysSize_;
+    KeysCapacity_ = header->KeysSize_;
+    KeysDead_ = 0;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::make_writable()
+{
+    if (!Mapping_.GetData())
+    {
+        return;
+    }
+
+    OAHTSlot* table = nullptr;
+    char* keys = nullptr;
+    unsigned capacity = KeysUsed_ > KEY_ARENA_SIZE ? KeysUsed_ : KEY_ARENA_SIZE;
+    try
+    {
+        table = new OAHTSlot[Stats_.TableSize_];
+        keys = new char[capacity];
+    }
+    catch (std::bad_alloc&)
+    {
+        delete[] table;
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Out of memory copying the mapped table");
+    }
+
+    std::size_t bytes = static_cast<std::size_t>(Stats_.TableSize_) * sizeof(OAHTSlot);
+    std::memcpy(static_cast<void*>(table), Table_, bytes);
+    std::memcpy(keys, Keys_, KeysUsed_);
+    Table_ = table;
+    Keys_ = keys;
+    KeysCapacity_ = capacity;
+    Mapping_.Close();
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::InitTable()
+{
+    for (unsigned i = 0; i < Stats_.TableSize_; i++)
+    {
+        Table_[i].State = OAHTSlot::UNOCCUPIED;
+    }
+    Stats_.Count_ = 0;
+    Stats_.Deleted_ = 0;
+
+    // Nothing references the arena anymore
+    KeysUsed_ = 0;
+    KeysDead_ = 0;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::GrowTable()
+{
+    unsigned newSize = NextSize(Stats_.TableSize_);
+
+    OAHTGrowth growth;
+    growth.Count_ = Stats_.Count_;
+    growth.Deleted_ = Stats_.Deleted_;
+    growth.OldSize_ = Stats_.TableSize_;
+    growth.Probes_ = Stats_.Probes_;
+
+    OAHTSlot* oldTable = Table_;
+    unsigned oldSize = Stats_.TableSize_;
+    for (bool placed = false; !placed;)
+    {
+        try
+        {
+            Table_ = new OAHTSlot[newSize];
+        }
+        catch (std::bad_alloc&)
+        {
+            Table_ = oldTable;
+            SetTableSize(oldSize);
+            throw OAHashTableException(
+                OAHashTableException::E_NO_MEMORY, "Out of memory growing the table");
+        }
+
+        SetTableSize(newSize);
+        for (unsigned i = 0; i < newSize; i++)
+        {
+            Table_[i].State = OAHTSlot::UNOCCUPIED;
+        }
+
+        // Only the slots move, the keys stay put in the arena. A full hash
+        // doesn't depend on the table size, so only PRIME needs the keys at
+        // all.
+        placed = true;
+        for (unsigned i = 0; i < oldSize && placed; i++)
+        {
+            if (oldTable[i].State == OAHTSlot::OCCUPIED)
+            {
+                OAHTSlot slot = oldTable[i];
+                if (Config_.Sizing_ == PRIME)
+                {
+                    slot.Hash = HashOf(GetKey(slot));
+                }
+                placed = Reinsert(slot);
+            }
+        }
+
+        // Some stride skips every free slot of this size, so try the next
+        if (!placed)
+        {
+            delete[] Table_;
+            Table_ = oldTable;
+            SetTableSize(oldSize);
+            newSize = NextSize(newSize);
+        }
+    }
+
+    if (Config_.Instrumented_)
+    {
+        growth.NewSize_ = newSize;
+        Profile_.Growth_.push_back(growth);
+    }
+
     delete[] oldTable;
+    Stats_.Deleted_ = 0;
+    Stats_.Expansions_++;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+unsigned OAHashTable<KeyType, T, Hasher, Eq>::NextSize(unsigned Size) const
+{
+    // Past MAX_PRIME (or 2^31 for powers of two) the table can't grow
+    double factor = std::ceil(Size * Config_.GrowthFactor_);
+    factor = factor < MAX_PRIME ? factor : MAX_PRIME;
+    unsigned size;
+    if (Config_.Sizing_ == POWER_OF_TWO)
+    {
+        size = GetNextPowerOfTwo(static_cast<unsigned>(factor));
+        size = size > Size ? size : Size * 2;
+    }
+    else if (Config_.Sizing_ == PRIME_FASTMOD)
+    {
+        // Ladder primes come with their reciprocals, and are at most 10%
+        // past the size asked for
+        size = GetLadderPrime(static_cast<unsigned>(factor)).Divisor_;
+        size = size > Size ? size : GetLadderPrime(Size + 1).Divisor_;
+    }
+    else
+    {
+        size = GetClosestPrime(static_cast<unsigned>(factor));
+        size = size > Size ? size : GetClosestPrime(Size + 1);
+    }
+
+    if (size <= Size)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Table can't grow any larger");
+    }
+    return size;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+int OAHashTable<KeyType, T, Hasher, Eq>::IndexOf(const KeyType& Key, OAHTSlot*& Slot) const
+{
+    return IndexOf(Key, HashOf(Key), Slot);
 }
 
-template <typename T>
-int OAHashTable<T>::IndexOf(const char* Key, OAHTSlot*& Slot) const
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+int OAHashTable<KeyType, T, Hasher, Eq>::IndexOf(
+    const KeyType& Key,
+    unsigned HashValue,
+    OAHTSlot*& Slot) const
 {
-    int index = Hash(Key) % Config_.TableSize;
-    int i = 0;
-    while (i < Config_.TableSize)
+    unsigned size = Stats_.TableSize_;
+    unsigned stride = StrideOf(Key);
+
+    // Slot ends up at the first place the key could go: a deleted slot
+    // if we pass one, otherwise the empty slot that ends the search
+    Slot = nullptr;
+    unsigned index = HomeOf(HashValue);
+    for (unsigned i = 0; i < size; i++)
     {
-        if (Config_.Table[index].State == OAHTSlot::OAHTSlotState::EMPTY)
+        Stats_.Probes_++;
+        OAHTSlot* current = &Table_[index];
+        if (current->State == OAHTSlot::UNOCCUPIED)
         {
-            Slot = &Config_.Table[index];
-            return index;
+            if (!Slot)
+            {
+                Slot = current;
+            }
+            return -1;
         }
-        if (Config_.Table[index].State == OAHTSlot::OAHTSlotState::OCCUPIED &&
-            strcmp(Config_.Table[index].Key, Key) == 0)
+
+        if (current->State == OAHTSlot::DELETED)
+        {
+            if (!Slot)
+            {
+                Slot = current;
+            }
+        }
+        else if (
+            current->Hash == HashValue && Equal_(KeyTraits::Load(Keys_, current->Key), Key))
         {
-            Slot = &Config_.Table[index];
-            return index;
+            Slot = current;
+            return static_cast<int>(index);
         }
-        index = (index + 1) % Config_.TableSize;
-        i++;
+
+        index = NextIndex(index, stride);
     }
+
     return -1;
 }
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+bool OAHashTable<KeyType, T, Hasher, Eq>::Reinsert(const OAHTSlot& Slot)
+{
+    unsigned stride = StrideOf(GetKey(Slot));
+    unsigned index = HomeOf(Slot.Hash);
+    int probes = 1;
+
+    Stats_.Probes_++;
+    while (Table_[index].State == OAHTSlot::OCCUPIED)
+    {
+        if (static_cast<unsigned>(probes) == Stats_.TableSize_)
+        {
+            return false;
+        }
+        index = NextIndex(index, stride);
+        Stats_.Probes_++;
+        probes++;
+    }
+
+    Table_[index] = Slot;
+    Table_[index].State = OAHTSlot::OCCUPIED;
+    Table_[index].probes = probes;
+    return true;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+unsigned OAHashTable<KeyType, T, Hasher, Eq>::StrideOf(const KeyType& Key) const
+{
+    if (!Config_.DoubleHashing_)
+    {
+        return 1;
+    }
+
+    switch (Config_.Sizing_)
+    {
+    case PRIME:
+        return Secondary_(Key, Stats_.TableSize_ - 1) + 1;
+    case PRIME_FASTMOD:
+        return StrideModulus_.Reduce(Secondary_(Key, ~0u)) + 1;
+    default:
+        // Any odd stride visits every slot of a power-of-two table
+        unsigned hash = static_cast<unsigned>(OAHTMix(Secondary_(Key, ~0u)));
+        return (hash & (Stats_.TableSize_ - 1)) | 1;
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+unsigned OAHashTable<KeyType, T, Hasher, Eq>::HashOf(const KeyType& Key) const
+{
+    switch (Config_.Sizing_)
+    {
+    case PRIME:
+        return Primary_(Key, Stats_.TableSize_);
+    case PRIME_FASTMOD:
+        return Primary_(Key, ~0u);
+    default:
+        // Mixed, because masking keeps only the low bits of a possibly weak hash
+        return static_cast<unsigned>(OAHTMix(Primary_(Key, ~0u)));
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+unsigned OAHashTable<KeyType, T, Hasher, Eq>::HomeOf(unsigned HashValue) const
+{
+    switch (Config_.Sizing_)
+    {
+    case PRIME:
+        return HashValue;
+    case PRIME_FASTMOD:
+        return Modulus_.Reduce(HashValue);
+    default:
+        return HashValue & (Stats_.TableSize_ - 1);
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+unsigned OAHashTable<KeyType, T, Hasher, Eq>::NextIndex(unsigned Index, unsigned Stride) const
+{
+    unsigned size = Stats_.TableSize_;
+    if (Config_.Sizing_ == POWER_OF_TWO)
+    {
+        return (Index + Stride) & (size - 1);
+    }
+
+    // Index and Stride are both below the size, so one subtraction wraps it
+    return Index >= size - Stride ? Index - (size - Stride) : Index + Stride;
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::SetTableSize(unsigned Size)
+{
+    Stats_.TableSize_ = Size;
+
+    // Sizes from the ladder don't need a division
+    const FastModulus& rung = GetLadderPrime(Size);
+    Modulus_ = rung.Divisor_ == Size ? rung : FastModulus(Size);
+    StrideModulus_ = FastModulus(Size - 1);
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::CheckWritable() const
+{
+    if (Mapping_.GetData())
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_READ_ONLY, "The table is mapped from a file (read-only)");
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::RecordProbes(unsigned* Histogram, unsigned Probes) const
+{
+    if (Config_.Instrumented_)
+    {
+        unsigned bucket = Probes ? Probes - 1 : 0;
+        Histogram[bucket < PROBE_HISTOGRAM_SIZE ? bucket : PROBE_HISTOGRAM_SIZE - 1]++;
+    }
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+typename OAHashTable<KeyType, T, Hasher, Eq>::KeyTraits::Stored
+OAHashTable<KeyType, T, Hasher, Eq>::StoreKey(const KeyType& Key)
+{
+    unsigned offset = 0;
+    if (KeyTraits::InArena)
+    {
+        const char* bytes = KeyTraits::Bytes(Key);
+        offset = OAHTAppendKey(Keys_, KeysUsed_, KeysCapacity_, bytes, KeyTraits::Length(Key));
+    }
+    return KeyTraits::Store(Key, offset);
+}
+
+template <typename KeyType, typename T, typename Hasher, typename Eq>
+void OAHashTable<KeyType, T, Hasher, Eq>::CompactKeys()
+{
+    OAHTCompactKeys(Keys_, KeysUsed_, KeysCapacity_, KeysDead_, [this](auto Move) {
+        for (unsigned i = 0; i < Stats_.TableSize_; i++)
+        {
+            OAHTSlot& slot = Table_[i];
+            if (KeyTraits::InArena && slot.State == OAHTSlot::OCCUPIED)
+            {
+                unsigned offset = KeyTraits::Offset(slot.Key);
+                KeyTraits::Move(slot.Key, Move(offset, KeyTraits::Size(slot.Key) - 1));
+            }
+        }
+    });
+}
@@ -2,8 +2,17 @@
 #ifndef OAHASHTABLEH
 #define OAHASHTABLEH
 //---------------------------------------------------------------------------
+#include "FileMapping.h"
 #include "Support.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <string>
+#include <vector>
+#if defined(_MSC_VER)
+#include <xmmintrin.h> // _mm_prefetch
+#endif
 
 /*!
 client-provided hash function: takes a key and table size,
@@ -11,8 +20,40 @@ returns an index in the table.
 */
 typedef unsigned (*HASHFUNC)(const char*, unsigned);
 
-//! Max length of our "string" keys
-const unsigned MAX_KEYLEN = 32;
+//! Initial capacity (in bytes) of the key arena
+const unsigned KEY_ARENA_SIZE = 256;
+
+//! Number of keys the batch operations hash and prefetch at a time
+const unsigned PREFETCH_BATCH = 16;
+
+//! Number of buckets in each probe length histogram
+const unsigned PROBE_HISTOGRAM_SIZE = 32;
+
+//! Hints the CPU to start loading Address into the cache
+inline void OAHTPrefetch(const void* Address)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(Address);
+#elif defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(Address), _MM_HINT_T0);
+#else
+    (void)Address;
+#endif
+}
+
+/*!
+Finalizer that spreads every input bit across the result, so keys that
+only differ in a few (or high) bits still land in different slots.
+*/
+inline std::size_t OAHTMix(unsigned long long Value)
+{
+    Value ^= Value >> 33;
+    Value *= 0xff51afd7ed558ccdULL;
+    Value ^= Value >> 33;
+    Value *= 0xc4ceb9fe1a85ec53ULL;
+    Value ^= Value >> 33;
+    return static_cast<std::size_t>(Value);
+}
 
 //! The exception class for the hash table
 class OAHashTableException
@@ -35,7 +76,8 @@ public:
         Retrieves exception code
 
         \return
-            One of: E_ITEM_NOT_FOUND, E_DUPLICATE, E_NO_MEMORY
+            One of: E_ITEM_NOT_FOUND, E_DUPLICATE, E_NO_MEMORY,
+            E_FILE_ERROR, E_READ_ONLY
     */
     virtual int code() const
     {
@@ -57,38 +99,327 @@ public:
     {
         E_ITEM_NOT_FOUND,
         E_DUPLICATE,
-        E_NO_MEMORY
+        E_NO_MEMORY,
+        E_FILE_ERROR,
+        E_READ_ONLY
     };
 };
 
-//! The policy used during a deletion
+//! The policy used during a deletion (tables that double hash PACK by
+//! rehashing in place, since a cluster of mixed strides can't be rebuilt)
 enum OAHTDeletionPolicy
 {
     MARK,
     PACK
 };
 
+/*!
+How the table is sized and how a hash becomes an index. With PRIME the
+hash functions are given the table size and do the modulo themselves.
+The other two ask the hash functions for a full 32-bit hash (by passing
+the largest table size) and reduce it here: by a multiply with a
+precomputed reciprocal of the prime size, or by mixing the hash and
+masking it to a power-of-two size.
+*/
+enum OAHTSizingPolicy
+{
+    PRIME,
+    PRIME_FASTMOD,
+    POWER_OF_TWO
+};
+
 //! OAHashTable statistical info
 struct OAHTStats
 {
     //! Default constructor
     OAHTStats()
-        : Count_(0), TableSize_(0), Probes_(0), Expansions_(0), PrimaryHashFunc_(0),
-          SecondaryHashFunc_(0){};
+        : Count_(0), TableSize_(0), Probes_(0), Expansions_(0), Deleted_(0), Rehashes_(0),
+          PrimaryHashFunc_(0), SecondaryHashFunc_(0){};
     unsigned Count_;             //!< Number of elements in the table
     unsigned TableSize_;         //!< Size of the table (total slots)
     unsigned Probes_;            //!< Number of probes performed
     unsigned Expansions_;        //!< Number of times the table grew
+    unsigned Deleted_;           //!< Number of DELETED slots (tombstones)
+    unsigned Rehashes_;          //!< Number of same-size rehashes
     HASHFUNC PrimaryHashFunc_;   //!< Pointer to primary hash function
     HASHFUNC SecondaryHashFunc_; //!< Pointer to secondary hash function
 };
 
-//! Hash table definition (open-addressing)
-template <typename T>
+//! The table at the time it grew
+struct OAHTGrowth
+{
+    unsigned Count_;   //!< Number of elements in the table
+    unsigned Deleted_; //!< Number of DELETED slots
+    unsigned OldSize_; //!< Size of the table before growing
+    unsigned NewSize_; //!< Size of the table after growing
+    unsigned Probes_;  //!< Number of probes performed up to then
+};
+
+/*!
+Detailed probe statistics, only gathered when OAHTConfig::Instrumented_
+is set. Bucket i of each histogram counts the operations that took i + 1
+probes, and the last bucket also counts everything longer than that.
+*/
+struct OAHTProfile
+{
+    //! Default constructor
+    OAHTProfile() : LongestCluster_(0)
+    {
+        for (unsigned i = 0; i < PROBE_HISTOGRAM_SIZE; i++)
+        {
+            FindHits_[i] = FindMisses_[i] = Inserts_[i] = Removes_[i] = 0;
+        }
+    }
+
+    unsigned FindHits_[PROBE_HISTOGRAM_SIZE];   //!< Probes of finds of a key in the table
+    unsigned FindMisses_[PROBE_HISTOGRAM_SIZE]; //!< Probes of finds of a missing key
+    unsigned Inserts_[PROBE_HISTOGRAM_SIZE];    //!< Probes to find a slot for an insert
+    unsigned Removes_[PROBE_HISTOGRAM_SIZE];    //!< Probes to find the key to remove
+    unsigned LongestCluster_;                   //!< Longest run of slots that aren't UNOCCUPIED
+    std::vector<OAHTGrowth> Growth_;            //!< Load factor timeline, one per GrowTable
+};
+
+/*!
+Non-owning view of a string key. A table copies the bytes into its key
+arena on insert, so a view only has to outlive the call it's passed to.
+*/
+struct OAHTStringRef
+{
+    //! Default constructor (empty string)
+    OAHTStringRef() : Data_(""), Length_(0){};
+
+    //! Conversion from a NUL-terminated string
+    OAHTStringRef(const char* String)
+        : Data_(String), Length_(static_cast<unsigned>(std::strlen(String))){};
+
+    //! Conversion from a pointer/length pair
+    OAHTStringRef(const char* String, unsigned Length) : Data_(String), Length_(Length){};
+
+    //! Conversion from a std::string
+    OAHTStringRef(const std::string& String)
+        : Data_(String.c_str()), Length_(static_cast<unsigned>(String.size())){};
+
+    const char* Data_; //!< First byte of the key
+    unsigned Length_;  //!< Number of bytes in the key
+};
+
+//! 64-bit FNV-1a of Length bytes, mixed
+inline std::size_t OAHTHashBytes(const char* Bytes, std::size_t Length)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < Length; i++)
+    {
+        hash ^= static_cast<unsigned char>(Bytes[i]);
+        hash *= 1099511628211ULL;
+    }
+    return OAHTMix(hash);
+}
+
+/*!
+Default hash functor for integer (and enum) keys. Hash functors follow the
+HASHFUNC convention: they return a hash below TableSize, and the largest
+table size (~0u) asks for a full 32-bit hash.
+*/
+template <typename Key>
+struct OAHTHash
+{
+    unsigned operator()(Key Value, unsigned TableSize) const
+    {
+        return static_cast<unsigned>(OAHTMix(static_cast<unsigned long long>(Value)) % TableSize);
+    }
+};
+
+//! Default hash functor for pointer keys (hashes the address, not the pointee)
+template <typename Key>
+struct OAHTHash<Key*>
+{
+    unsigned operator()(Key* Value, unsigned TableSize) const
+    {
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(Value);
+        return static_cast<unsigned>(OAHTMix(address) % TableSize);
+    }
+};
+
+//! Except C strings, which are hashed by contents
+template <>
+struct OAHTHash<const char*>
+{
+    unsigned operator()(const char* Value, unsigned TableSize) const
+    {
+        return static_cast<unsigned>(OAHTHashBytes(Value, std::strlen(Value)) % TableSize);
+    }
+};
+
+//! Default hash functor for string view keys
+template <>
+struct OAHTHash<OAHTStringRef>
+{
+    unsigned operator()(const OAHTStringRef& Value, unsigned TableSize) const
+    {
+        return static_cast<unsigned>(OAHTHashBytes(Value.Data_, Value.Length_) % TableSize);
+    }
+};
+
+//! Default key comparison functor
+template <typename Key>
+struct OAHTEqual
+{
+    bool operator()(const Key& Left, const Key& Right) const
+    {
+        return Left == Right;
+    }
+};
+
+//! C strings compare by contents
+template <>
+struct OAHTEqual<const char*>
+{
+    bool operator()(const char* Left, const char* Right) const
+    {
+        return std::strcmp(Left, Right) == 0;
+    }
+};
+
+//! So do string views
+template <>
+struct OAHTEqual<OAHTStringRef>
+{
+    bool operator()(const OAHTStringRef& Left, const OAHTStringRef& Right) const
+    {
+        return Left.Length_ == Right.Length_ &&
+               std::memcmp(Left.Data_, Right.Data_, Left.Length_) == 0;
+    }
+};
+
+//! Adapts a client HASHFUNC to the functor interface, for C string keys
+class OAHTFuncHash
+{
+public:
+    //! Non-default constructor
+    OAHTFuncHash(HASHFUNC Func = 0) : Func_(Func){};
+
+    unsigned operator()(const char* Value, unsigned TableSize) const
+    {
+        return Func_(Value, TableSize);
+    }
+
+private:
+    HASHFUNC Func_; //!< The adapted hash function
+};
+
+//! Where a string key's bytes are in the key arena
+struct OAHTArenaKey
+{
+    unsigned Offset; //!< Offset of the key in the key arena
+    unsigned Length; //!< Length of the key (not counting the terminator)
+};
+
+/*!
+How a table stores keys of type Key in its slots. Integer, enum and
+pointer keys are stored as they are, and take no room in the key arena.
+*/
+template <typename Key>
+struct OAHTKeyTraits
+{
+    typedef Key Stored;                //!< What a slot holds
+    static const bool InArena = false; //!< Whether the key's bytes live in the key arena
+
+    //! Returns the key that Value (a slot's key) stands for
+    static Key Load(const char*, const Stored& Value) { return Value; }
+
+    //! The bytes to copy to the arena, and how many there are
+    static const char* Bytes(const Key&) { return nullptr; }
+    static unsigned Length(const Key&) { return 0; }
+
+    //! What a slot holds for Value, whose bytes were copied to Offset
+    static Stored Store(const Key& Value, unsigned) { return Value; }
+
+    //! Arena bytes Value takes (terminator included) and where they are
+    static unsigned Size(const Stored&) { return 0; }
+    static unsigned Offset(const Stored&) { return 0; }
+
+    //! Points Value at a new copy of its bytes
+    static void Move(Stored&, unsigned) {}
+
+    //! Whether Value's bytes lie inside an arena of KeysSize bytes
+    static bool Fits(const Stored&, const char*, unsigned) { return true; }
+};
+
+//! The parts of the traits that string keys share
+struct OAHTArenaKeyTraits
+{
+    typedef OAHTArenaKey Stored;
+    static const bool InArena = true;
+
+    static unsigned Size(const Stored& Value) { return Value.Length + 1; }
+    static unsigned Offset(const Stored& Value) { return Value.Offset; }
+    static void Move(Stored& Value, unsigned Offset) { Value.Offset = Offset; }
+
+    static Stored Store(unsigned Offset, unsigned Length)
+    {
+        Stored stored;
+        stored.Offset = Offset;
+        stored.Length = Length;
+        return stored;
+    }
+
+    static bool Fits(const Stored& Value, const char* Keys, unsigned KeysSize)
+    {
+        return Value.Offset < KeysSize && Value.Length < KeysSize - Value.Offset &&
+               Keys[Value.Offset + Value.Length] == 0;
+    }
+};
+
+//! C string keys are copied to the key arena
+template <>
+struct OAHTKeyTraits<const char*> : OAHTArenaKeyTraits
+{
+    static const char* Load(const char* Keys, const Stored& Value) { return Keys + Value.Offset; }
+    static const char* Bytes(const char* Value) { return Value; }
+    static unsigned Length(const char* Value) { return static_cast<unsigned>(std::strlen(Value)); }
+
+    static Stored Store(const char* Value, unsigned Offset)
+    {
+        return OAHTArenaKeyTraits::Store(Offset, Length(Value));
+    }
+};
+
+//! And so are the bytes of string view keys
+template <>
+struct OAHTKeyTraits<OAHTStringRef> : OAHTArenaKeyTraits
+{
+    static OAHTStringRef Load(const char* Keys, const Stored& Value)
+    {
+        return OAHTStringRef(Keys + Value.Offset, Value.Length);
+    }
+    static const char* Bytes(const OAHTStringRef& Value) { return Value.Data_; }
+    static unsigned Length(const OAHTStringRef& Value) { return Value.Length_; }
+
+    static Stored Store(const OAHTStringRef& Value, unsigned Offset)
+    {
+        return OAHTArenaKeyTraits::Store(Offset, Value.Length_);
+    }
+};
+
+/*!
+Hash table definition (open-addressing). Keys can be integers, enums,
+pointers (compared by address), C strings or OAHTStringRef views; the
+bytes of string keys are copied to a key arena owned by the table. Hashing
+and key comparison are functors, so they are inlined into the probe loop.
+
+OAHashTable<T> (no key type) is the original interface: C string keys and
+HASHFUNC function pointers, see the specialization below.
+*/
+template <
+    typename KeyType,
+    typename T = void,
+    typename Hasher = OAHTHash<KeyType>,
+    typename Eq = OAHTEqual<KeyType>>
 class OAHashTable
 {
 public:
     typedef void (*FREEPROC)(T); //!< client-provided free proc (we own the data)
+    typedef OAHTKeyTraits<KeyType> KeyTraits;
 
     //! Configuration for the hash table
     struct OAHTConfig
@@ -96,27 +427,32 @@ public:
         //! Non-default constructor
         OAHTConfig(
             unsigned InitialTableSize,
-            HASHFUNC PrimaryHashFunc,
-            HASHFUNC SecondaryHashFunc = 0,
+            bool DoubleHashing = false,
             double MaxLoadFactor = 0.5,
             double GrowthFactor = 2.0,
             OAHTDeletionPolicy Policy = PACK,
-            FREEPROC FreeProc = 0)
+            FREEPROC FreeProc = 0,
+            OAHTSizingPolicy Sizing = PRIME,
+            double MaxDeletedFactor = 0,
+            bool Instrumented = false)
             :
 
-              InitialTableSize_(InitialTableSize), PrimaryHashFunc_(PrimaryHashFunc),
-              SecondaryHashFunc_(SecondaryHashFunc), MaxLoadFactor_(MaxLoadFactor),
-              GrowthFactor_(GrowthFactor), DeletionPolicy_(Policy), FreeProc_(FreeProc)
+              InitialTableSize_(InitialTableSize), DoubleHashing_(DoubleHashing),
+              MaxLoadFactor_(MaxLoadFactor), GrowthFactor_(GrowthFactor), DeletionPolicy_(Policy),
+              FreeProc_(FreeProc), Sizing_(Sizing), MaxDeletedFactor_(MaxDeletedFactor),
+              Instrumented_(Instrumented)
         {
         }
 
         unsigned InitialTableSize_;         //!< The starting table size
-        HASHFUNC PrimaryHashFunc_;          //!< First hash function
-        HASHFUNC SecondaryHashFunc_;        //!< Hash function to resolve collisions
+        bool DoubleHashing_;                //!< Probe with a stride from the secondary hash
         double MaxLoadFactor_;              //!< Maximum LF before growing
         double GrowthFactor_;               //!< The amount to grow the table
         OAHTDeletionPolicy DeletionPolicy_; //!< MARK or PACK
         FREEPROC FreeProc_;                 //!< Client-provided free function
+        OAHTSizingPolicy Sizing_;           //!< PRIME, PRIME_FASTMOD or POWER_OF_TWO
+        double MaxDeletedFactor_;           //!< Max fraction of DELETED slots (0: no limit)
+        bool Instrumented_;                 //!< Gather an OAHTProfile (costs a little time)
     };
 
     //! Slots that will hold the key/data pairs
@@ -130,53 +466,345 @@ public:
             DELETED
         };
 
-        char Key[MAX_KEYLEN]; //!< Key is a string
-        T Data;               //!< Client data
-        OAHTSlot_State State; //!< The state of the slot
-        int probes;           //!< For testing
+        typename KeyTraits::Stored Key; //!< The key, or where it is in the key arena
+        unsigned Hash;                  //!< Home index (PRIME sizing) or full hash of the key
+        T Data;                         //!< Client data
+        OAHTSlot_State State;           //!< The state of the slot
+        int probes;                     //!< For testing
+    };
+
+    //! Forward iterator over the occupied slots, in table order
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef OAHTSlot value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const OAHTSlot* pointer;
+        typedef const OAHTSlot& reference;
+
+        const_iterator() : Keys_(nullptr), Slot_(nullptr), End_(nullptr) {}
+
+        reference operator*() const { return *Slot_; }
+        pointer operator->() const { return Slot_; }
+
+        //! The key of the slot
+        KeyType key() const { return KeyTraits::Load(Keys_, Slot_->Key); }
+
+        const_iterator& operator++()
+        {
+            ++Slot_;
+            Skip();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& Other) const { return Slot_ == Other.Slot_; }
+        bool operator!=(const const_iterator& Other) const { return Slot_ != Other.Slot_; }
+
+    private:
+        friend class OAHashTable;
+
+        const_iterator(const char* Keys, const OAHTSlot* Slot, const OAHTSlot* End)
+            : Keys_(Keys), Slot_(Slot), End_(End)
+        {
+            Skip();
+        }
+
+        //! Moves past UNOCCUPIED and DELETED slots
+        void Skip()
+        {
+            while (Slot_ != End_ && Slot_->State != OAHTSlot::OCCUPIED)
+            {
+                ++Slot_;
+            }
+        }
+
+        const char* Keys_;     //!< The key arena of the table
+        const OAHTSlot* Slot_; //!< Current slot (End_ when done)
+        const OAHTSlot* End_;  //!< One past the last slot
     };
 
-    OAHashTable(const OAHTConfig& Config); // Constructor
-    ~OAHashTable();                        // Destructor
+    // Constructor. Secondary gives the probe stride when DoubleHashing_ is
+    // set, and should hash differently from Primary (with PRIME and
+    // PRIME_FASTMOD sizing the stride is reduced differently from the home
+    // index, so the same functor works too).
+    OAHashTable(
+        const OAHTConfig& Config,
+        const Hasher& Primary = Hasher(),
+        const Hasher& Secondary = Hasher(),
+        const Eq& Equal = Eq());
+    ~OAHashTable(); // Destructor
+
+    // Builds a table holding Count key/data pairs. The table starts at the
+    // size inserting them one at a time would have grown it to, and Threads
+    // threads (0: one per core) insert them, claiming slots atomically.
+    // Finds give the same results as after inserting the pairs in a loop.
+    // If some key's probe sequence never reaches a free slot, the pairs
+    // are inserted one at a time instead. Throws E_DUPLICATE if a key is in
+    // Keys twice.
+    OAHashTable(
+        const OAHTConfig& Config,
+        const KeyType* Keys,
+        const T* Data,
+        size_t Count,
+        unsigned Threads = 0,
+        const Hasher& Primary = Hasher(),
+        const Hasher& Secondary = Hasher(),
+        const Eq& Equal = Eq());
 
     // Insert a key/data pair into table. Throws an exception if the
     // insertion is unsuccessful.
-    void insert(const char* Key, const T& Data);
+    void insert(const KeyType& Key, const T& Data);
 
     // Delete an item by key. Throws an exception if the key doesn't exist.
     // Compacts the table by moving key/data pairs, if necessary
-    void remove(const char* Key);
+    void remove(const KeyType& Key);
 
     // Find and return data by key. Throws an exception (E_ITEM_NOT_FOUND)
     // if not found.
-    const T& find(const char* Key) const;
+    const T& find(const KeyType& Key) const;
+
+    // Finds Count keys at once. Data[i] is set to the data for Keys[i], or
+    // to 0 if that key isn't in the table. Each group of keys is hashed and
+    // has its home slots prefetched before any probing, so the cache misses
+    // overlap instead of being paid one after another.
+    void find_batch(const KeyType* Keys, size_t Count, const T** Data) const;
+
+    // Inserts Count key/data pairs, hashing and prefetching like find_batch.
+    // Throws like insert on the first failure (earlier pairs stay inserted).
+    void insert_batch(const KeyType* Keys, const T* Data, size_t Count);
 
     // Removes all items from the table (Doesn't deallocate table)
     void clear();
 
+    // Rehashes every item in place, at the same size, which turns all
+    // DELETED slots back into UNOCCUPIED ones. If MaxDeletedFactor is set,
+    // remove does this on its own once the DELETED slots pass that fraction
+    // of the table.
+    void rehash();
+
+    // Iterate over the occupied slots. Anything that changes the table
+    // invalidates them.
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Calls Func(Key, Data) for every item, with the slots split across
+    // Threads threads (0: one per core), so Func must be safe to call from
+    // several threads at once and must not change the table. If Func
+    // throws, the first exception is rethrown once every thread is done.
+    template <typename F>
+    void parallel_for_each(F Func, unsigned Threads = 0) const;
+
     // Allow the client to peer into the data
     OAHTStats GetStats() const;
     const OAHTSlot* GetTable() const;
 
+    // Returns the probe histograms and growth timeline gathered so far (empty
+    // unless the table is Instrumented_), and measures the longest cluster
+    OAHTProfile GetProfile() const;
+
+    // Returns the key of an occupied slot from GetTable (C string keys are
+    // NUL-terminated)
+    KeyType GetKey(const OAHTSlot& Slot) const;
+
+    // Writes the table to Path: a header, the slots, then the keys of the
+    // occupied slots. Slots refer to their keys by offset, so the file can
+    // be used wherever it ends up in memory. T (and non-string keys) are
+    // written as raw bytes, so they must be trivially copyable and shouldn't
+    // point at anything.
+    void save(const char* Path) const;
+
+    // Replaces the contents of the table with a table saved in Path. The
+    // file is mapped, not read, so lookups can start right away and pages
+    // are loaded as they are touched. The config must use the same sizing
+    // policy and hash functions the saved table did. Every slot is checked
+    // once while loading, and a damaged file throws E_FILE_ERROR. Changing
+    // a mapped table throws E_READ_ONLY until make_writable is called.
+    void load_mapped(const char* Path);
+
+    // Copies a mapped table into memory owned by the table and unmaps the
+    // file, so the table can be changed again. Does nothing otherwise.
+    void make_writable();
+
 private: // Some suggestions (You don't have to use any of this.)
          // Initialize the table after an allocation
     void InitTable();
 
     // Expands the table when the load factor reaches a certain point
     // (greater than MaxLoadFactor) Grows the table by GrowthFactor,
-    // making sure the new size is prime by calling GetClosestPrime
+    // making sure the new size is prime by calling GetClosestPrime (or
+    // GetLadderPrime, for PRIME_FASTMOD). Goes on to the size after that if
+    // some item's probe sequence has no free slot at the new size.
     void GrowTable();
 
+    // Returns the size the table grows to from Size
+    unsigned NextSize(unsigned Size) const;
+
     // Workhorse method to locate an item (if it exists)
     // Returns the index of the item in the table
     // Sets Slot to point to the slot in the table where it belongs
     // Returns -1 if it's not in the table
-    int IndexOf(const char* Key, OAHTSlot*& Slot) const;
+    int IndexOf(const KeyType& Key, OAHTSlot*& Slot) const;
+
+    // Same as above, with the key's hash (see OAHTSlot::Hash) already computed
+    int IndexOf(const KeyType& Key, unsigned HashValue, OAHTSlot*& Slot) const;
+
+    // Inserts a key with a known hash (no load factor check)
+    void InsertAt(const KeyType& Key, unsigned HashValue, const T& Data);
+
+    // Returns the value stored in OAHTSlot::Hash for Key
+    unsigned HashOf(const KeyType& Key) const;
+
+    // Returns the home index of a key with this hash
+    unsigned HomeOf(unsigned HashValue) const;
+
+    // Returns the index after Index when probing with Stride
+    unsigned NextIndex(unsigned Index, unsigned Stride) const;
+
+    // Sets up the table size dependent parts of the reduction
+    void SetTableSize(unsigned Size);
+
+    // Places an occupied slot's key/data into the first free slot of its probe
+    // sequence. The key bytes stay where they are in the arena. Returns false
+    // if the sequence comes back around without finding one.
+    bool Reinsert(const OAHTSlot& Slot);
+
+    // Returns the stride used to probe for Key (1 for linear probing)
+    unsigned StrideOf(const KeyType& Key) const;
+
+    // Returns what a slot holds for Key, copying its bytes to the key arena
+    // if it has any
+    typename KeyTraits::Stored StoreKey(const KeyType& Key);
+
+    // Rewrites the key arena so that only keys of occupied slots remain
+    void CompactKeys();
+
+    // Throws E_READ_ONLY if the table is a mapped file
+    void CheckWritable() const;
+
+    // Counts an operation that took Probes probes in Histogram (if Instrumented_)
+    void RecordProbes(unsigned* Histogram, unsigned Probes) const;
+
+    //! Start of a saved table, followed by the slots and then the keys
+    struct FileHeader
+    {
+        char Magic_[4];        //!< "OAHT"
+        unsigned Version_;     //!< Format version of the file
+        unsigned ByteOrder_;   //!< 0x01020304, as the saving machine stored it
+        unsigned SlotSize_;    //!< sizeof(OAHTSlot), which differs with T
+        unsigned Sizing_;      //!< OAHTSizingPolicy of the saved table
+        unsigned TableSize_;   //!< Number of slots
+        unsigned Count_;       //!< Number of occupied slots
+        unsigned Deleted_;     //!< Number of deleted slots
+        unsigned KeysSize_;    //!< Bytes of keys after the slots
+        unsigned Reserved_[7]; //!< Zero, and keeps the slots 64-byte aligned
+    };
 
     // Other private fields and methods...
     OAHTConfig Config_;
-    OAHTStats Stats_;
+    mutable OAHTStats Stats_;
+    mutable OAHTProfile Profile_;
     OAHTSlot* Table_;
+    Hasher Primary_;   //!< Hashes keys to their home slot
+    Hasher Secondary_; //!< Hashes keys to their probe stride (DoubleHashing_)
+    Eq Equal_;       //!< Compares keys
+
+    FastModulus Modulus_;       //!< Reciprocal of the table size (PRIME_FASTMOD)
+    FastModulus StrideModulus_; //!< Reciprocal of the table size - 1 (PRIME_FASTMOD)
+
+    char* Keys_;            //!< Append-only arena holding the string keys' bytes
+    unsigned KeysUsed_;     //!< Bytes of the arena in use (live or not)
+    unsigned KeysCapacity_; //!< Allocated size of the arena
+    unsigned KeysDead_;     //!< Bytes in use by keys that were removed
+
+    FileMapping Mapping_; //!< The file holding the slots and keys, if mapped
+};
+
+/*!
+OAHashTable<T>: C string keys, hashed by client HASHFUNCs given in the
+config. Everything else comes from OAHashTable<const char*, T>.
+*/
+template <typename T>
+class OAHashTable<T, void, OAHTHash<T>, OAHTEqual<T>>
+    : public OAHashTable<const char*, T, OAHTFuncHash>
+{
+    typedef OAHashTable<const char*, T, OAHTFuncHash> Base;
+
+public:
+    typedef typename Base::FREEPROC FREEPROC;
+
+    //! Configuration for the hash table
+    struct OAHTConfig : Base::OAHTConfig
+    {
+        //! Non-default constructor
+        OAHTConfig(
+            unsigned InitialTableSize,
+            HASHFUNC PrimaryHashFunc,
+            HASHFUNC SecondaryHashFunc = 0,
+            double MaxLoadFactor = 0.5,
+            double GrowthFactor = 2.0,
+            OAHTDeletionPolicy Policy = PACK,
+            FREEPROC FreeProc = 0,
+            OAHTSizingPolicy Sizing = PRIME,
+            double MaxDeletedFactor = 0,
+            bool Instrumented = false)
+            : Base::OAHTConfig(
+                  InitialTableSize,
+                  SecondaryHashFunc != 0,
+                  MaxLoadFactor,
+                  GrowthFactor,
+                  Policy,
+                  FreeProc,
+                  Sizing,
+                  MaxDeletedFactor,
+                  Instrumented),
+              PrimaryHashFunc_(PrimaryHashFunc), SecondaryHashFunc_(SecondaryHashFunc)
+        {
+        }
+
+        HASHFUNC PrimaryHashFunc_;   //!< First hash function
+        HASHFUNC SecondaryHashFunc_; //!< Hash function to resolve collisions
+    };
+
+    //! Constructor
+    OAHashTable(const OAHTConfig& Config)
+        : Base(Config, Config.PrimaryHashFunc_, Config.SecondaryHashFunc_),
+          PrimaryHashFunc_(Config.PrimaryHashFunc_), SecondaryHashFunc_(Config.SecondaryHashFunc_)
+    {
+    }
+
+    //! Bulk build (see OAHashTable<Key, T>)
+    OAHashTable(
+        const OAHTConfig& Config,
+        const char* const* Keys,
+        const T* Data,
+        size_t Count,
+        unsigned Threads = 0)
+        : Base(Config, Keys, Data, Count, Threads, Config.PrimaryHashFunc_,
+               Config.SecondaryHashFunc_),
+          PrimaryHashFunc_(Config.PrimaryHashFunc_), SecondaryHashFunc_(Config.SecondaryHashFunc_)
+    {
+    }
+
+    //! The stats, with the hash functions filled in
+    OAHTStats GetStats() const
+    {
+        OAHTStats stats = Base::GetStats();
+        stats.PrimaryHashFunc_ = PrimaryHashFunc_;
+        stats.SecondaryHashFunc_ = SecondaryHashFunc_;
+        return stats;
+    }
+
+private:
+    HASHFUNC PrimaryHashFunc_;   //!< First hash function
+    HASHFUNC SecondaryHashFunc_; //!< Hash function to resolve collisions
 };
 
 #include "OAHashTable.cpp"
@@ -0,0 +1,287 @@
+#include "PerfectHashTable.h"
+#include <algorithm>
+#include <climits>
+#include <new>
+#include <vector>
+
+template <typename T>
+PerfectHashTable<T>::PerfectHashTable(const char* const* Keys, const T* Data, size_t Count)
+    : Seed_(0), BucketCount_(0), Pilots_(nullptr), KeyOffsets_(nullptr), Data_(nullptr),
+      Keys_(nullptr), KeysSize_(0)
+{
+    Build(Keys, Data, Count);
+}
+
+template <typename T>
+PerfectHashTable<T>::PerfectHashTable(const OAHashTable<T>& Table)
+    : Seed_(0), BucketCount_(0), Pilots_(nullptr), KeyOffsets_(nullptr), Data_(nullptr),
+      Keys_(nullptr), KeysSize_(0)
+{
+    std::vector<const char*> keys;
+    std::vector<T> data;
+    const typename OAHashTable<T>::OAHTSlot* slots = Table.GetTable();
+    for (unsigned i = 0; i < Table.GetStats().TableSize_; i++)
+    {
+        if (slots[i].State == OAHashTable<T>::OAHTSlot::OCCUPIED)
+        {
+            keys.push_back(Table.GetKey(slots[i]));
+            data.push_back(slots[i].Data);
+        }
+    }
+    Build(keys.data(), data.data(), keys.size());
+}
+
+template <typename T>
+PerfectHashTable<T>::~PerfectHashTable()
+{
+    Free();
+}
+
+template <typename T>
+const T& PerfectHashTable<T>::find(const char* Key) const
+{
+    Stats_.Probes_++;
+    if (Stats_.Count_)
+    {
+        unsigned long long hash = WyHash64(Key, std::strlen(Key), Seed_);
+        unsigned slot = SlotOf(hash, Pilots_[BucketOf(hash)]);
+
+        // Every key lands on some slot, so make sure it's this key's
+        if (std::strcmp(Keys_ + KeyOffsets_[slot], Key) == 0)
+        {
+            return Data_[slot];
+        }
+    }
+
+    throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, "Key not in table.");
+}
+
+template <typename T>
+OAHTStats PerfectHashTable<T>::GetStats() const
+{
+    return Stats_;
+}
+
+template <typename T>
+size_t PerfectHashTable<T>::GetMemoryUsed() const
+{
+    return BucketCount_ * sizeof(unsigned) + Stats_.TableSize_ * (sizeof(unsigned) + sizeof(T)) +
+           KeysSize_;
+}
+
+template <typename T>
+void PerfectHashTable<T>::Build(const char* const* Keys, const T* Data, size_t Count)
+{
+    if (Count >= ~0u)
+    {
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Too many items for one table");
+    }
+    unsigned count = static_cast<unsigned>(Count);
+    Stats_.Count_ = count;
+    Stats_.TableSize_ = count;
+    BucketCount_ = count / PERFECT_BUCKET_KEYS + 1;
+
+    try
+    {
+        Pilots_ = new unsigned[BucketCount_];
+        KeyOffsets_ = new unsigned[count];
+        Data_ = new T[count];
+
+        // Almost every seed works, and each try makes failing again less
+        // likely, so running out of seeds means something is wrong with the
+        // keys (duplicates throw on their own)
+        std::vector<unsigned long long> hashes(count);
+        std::vector<unsigned> positions(count);
+        for (unsigned attempt = 0;; attempt++)
+        {
+            if (attempt == PERFECT_MAX_SEEDS)
+            {
+                throw OAHashTableException(
+                    OAHashTableException::E_NO_MEMORY, "No seed gives a perfect hash");
+            }
+
+            Seed_ = OAHTMix(attempt + 1);
+            for (unsigned i = 0; i < count; i++)
+            {
+                hashes[i] = WyHash64(Keys[i], std::strlen(Keys[i]), Seed_);
+            }
+
+            if (FindPilots(hashes.data(), Keys, positions.data()))
+            {
+                break;
+            }
+            Stats_.Expansions_++;
+        }
+
+        // Keys are stored in slot order, so a scan of the slots reads the
+        // keys front to back
+        std::vector<unsigned> order(count);
+        for (unsigned i = 0; i < count; i++)
+        {
+            order[positions[i]] = i;
+            KeysSize_ += std::strlen(Keys[i]) + 1;
+        }
+
+        // Key offsets are stored as unsigned
+        if (KeysSize_ > ~0u)
+        {
+            throw OAHashTableException(OAHashTableException::E_NO_MEMORY, "Key arena is full");
+        }
+
+        Keys_ = new char[KeysSize_ ? KeysSize_ : 1];
+        size_t offset = 0;
+        for (unsigned slot = 0; slot < count; slot++)
+        {
+            const char* key = Keys[order[slot]];
+            size_t length = std::strlen(key) + 1;
+            std::memcpy(Keys_ + offset, key, length);
+            KeyOffsets_[slot] = static_cast<unsigned>(offset);
+            Data_[slot] = Data[order[slot]];
+            offset += length;
+        }
+    }
+    catch (std::bad_alloc&)
+    {
+        Free();
+        throw OAHashTableException(
+            OAHashTableException::E_NO_MEMORY, "Out of memory building the table");
+    }
+    catch (...)
+    {
+        Free();
+        throw;
+    }
+}
+
+template <typename T>
+bool PerfectHashTable<T>::FindPilots(
+    const unsigned long long* Hashes,
+    const char* const* Keys,
+    unsigned* Positions)
+{
+    unsigned count = Stats_.Count_;
+
+    // Group the keys by bucket
+    std::vector<unsigned> starts(BucketCount_ + 1, 0);
+    for (unsigned i = 0; i < count; i++)
+    {
+        starts[BucketOf(Hashes[i]) + 1]++;
+    }
+    for (unsigned bucket = 0; bucket < BucketCount_; bucket++)
+    {
+        starts[bucket + 1] += starts[bucket];
+    }
+    std::vector<unsigned> members(count);
+    std::vector<unsigned> next(starts.begin(), starts.end() - 1);
+    for (unsigned i = 0; i < count; i++)
+    {
+        members[next[BucketOf(Hashes[i])]++] = i;
+    }
+
+    // The biggest buckets are the hardest to place, so they go first,
+    // while most of the slots are still free
+    std::vector<unsigned> order(BucketCount_);
+    for (unsigned bucket = 0; bucket < BucketCount_; bucket++)
+    {
+        order[bucket] = bucket;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned Left, unsigned Right) {
+        return starts[Left + 1] - starts[Left] > starts[Right + 1] - starts[Right];
+    });
+
+    // The last buckets have to hit one of the few slots left, which takes
+    // about count tries. A bucket needing far more than that won't make it.
+    // Pilots are stored as unsigned, so the search stops short of UINT_MAX.
+    unsigned long long maxPilot = 64ULL * count + 1024;
+    if (maxPilot > UINT_MAX)
+    {
+        maxPilot = UINT_MAX;
+    }
+    std::vector<char> taken(count, 0);
+    std::vector<unsigned> slots;
+    for (unsigned i = 0; i < BucketCount_; i++)
+    {
+        unsigned bucket = order[i];
+        const unsigned* first = members.data() + starts[bucket];
+        unsigned size = starts[bucket + 1] - starts[bucket];
+        Pilots_[bucket] = 0;
+
+        // No pilot separates keys with the same hash
+        for (unsigned j = 0; j < size; j++)
+        {
+            for (unsigned k = j + 1; k < size; k++)
+            {
+                if (Hashes[first[j]] != Hashes[first[k]])
+                {
+                    continue;
+                }
+                if (std::strcmp(Keys[first[j]], Keys[first[k]]) == 0)
+                {
+                    throw OAHashTableException(
+                        OAHashTableException::E_DUPLICATE, "Item being inserted is a duplicate");
+                }
+                return false;
+            }
+        }
+
+        slots.resize(size);
+        for (unsigned long long pilot = 0; size; pilot++)
+        {
+            if (pilot == maxPilot)
+            {
+                return false;
+            }
+
+            bool fits = true;
+            for (unsigned j = 0; j < size && fits; j++)
+            {
+                slots[j] = SlotOf(Hashes[first[j]], static_cast<unsigned>(pilot));
+                fits = !taken[slots[j]];
+                for (unsigned k = 0; k < j && fits; k++)
+                {
+                    fits = slots[k] != slots[j];
+                }
+            }
+
+            if (fits)
+            {
+                for (unsigned j = 0; j < size; j++)
+                {
+                    taken[slots[j]] = 1;
+                    Positions[first[j]] = slots[j];
+                }
+                Pilots_[bucket] = static_cast<unsigned>(pilot);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename T>
+unsigned PerfectHashTable<T>::BucketOf(unsigned long long Hash) const
+{
+    // The high half, scaled to the bucket count (no division)
+    return static_cast<unsigned>(((Hash >> 32) * BucketCount_) >> 32);
+}
+
+template <typename T>
+unsigned PerfectHashTable<T>::SlotOf(unsigned long long Hash, unsigned Pilot) const
+{
+    unsigned long long mixed = OAHTMix(Hash ^ (Pilot * 0x9e3779b97f4a7c15ULL));
+    return static_cast<unsigned>(((mixed & 0xffffffffULL) * Stats_.TableSize_) >> 32);
+}
+
+template <typename T>
+void PerfectHashTable<T>::Free()
+{
+    delete[] Pilots_;
+    delete[] KeyOffsets_;
+    delete[] Data_;
+    delete[] Keys_;
+    Pilots_ = nullptr;
+    KeyOffsets_ = nullptr;
+    Data_ = nullptr;
+    Keys_ = nullptr;
+}
@@ -0,0 +1,88 @@
+//---------------------------------------------------------------------------
+#ifndef PERFECTHASHTABLEH
+#define PERFECTHASHTABLEH
+//---------------------------------------------------------------------------
+#include "HashFuncs.h"
+#include "OAHashTable.h"
+
+//! Average number of keys per bucket of a PerfectHashTable (more: smaller, slower to build)
+const unsigned PERFECT_BUCKET_KEYS = 4;
+
+//! Seeds a PerfectHashTable tries before it gives up on a set of keys
+const unsigned PERFECT_MAX_SEEDS = 64;
+
+/*!
+Read-only table built once from a fixed set of keys, using a minimal
+perfect hash in the style of CHD/PTHash. Keys are hashed into buckets of
+a few keys each, and every bucket stores a small "pilot" that moves its
+keys to slots no other key uses. So there are exactly as many slots as
+keys, and a find is one hash, one pilot and one slot. The slot's key is
+compared against the one looked up, so missing keys are never mistaken
+for a key in the table.
+
+Keys are hashed with WyHash64 (the builder needs a hash it can seed).
+Same exceptions and stats as OAHashTable.
+*/
+template <typename T>
+class PerfectHashTable
+{
+public:
+    // Builds a table from Count keys and their data. Throws E_DUPLICATE if
+    // a key is in Keys twice, and E_NO_MEMORY if none of the first
+    // PERFECT_MAX_SEEDS seeds gives a perfect hash.
+    PerfectHashTable(const char* const* Keys, const T* Data, size_t Count);
+
+    // Builds a table holding the same items as Table
+    PerfectHashTable(const OAHashTable<T>& Table);
+
+    ~PerfectHashTable(); // Destructor
+
+    // Find and return data by key. Throws an exception (E_ITEM_NOT_FOUND)
+    // if not found.
+    const T& find(const char* Key) const;
+
+    // Allow the client to peer into the data. Probes_ counts finds, the
+    // one slot each of them looks at.
+    OAHTStats GetStats() const;
+
+    // Bytes used by the pilots, slots and keys
+    size_t GetMemoryUsed() const;
+
+private:
+    // Not copyable
+    PerfectHashTable(const PerfectHashTable&);
+    PerfectHashTable& operator=(const PerfectHashTable&);
+
+    // Finds pilots for Count keys and fills in the slots
+    void Build(const char* const* Keys, const T* Data, size_t Count);
+
+    // Tries to find a pilot for every bucket with the keys hashed with Seed_.
+    // Returns false if some bucket has no pilot that works.
+    bool FindPilots(
+        const unsigned long long* Hashes,
+        const char* const* Keys,
+        unsigned* Positions);
+
+    // Returns the bucket of a key with this hash
+    unsigned BucketOf(unsigned long long Hash) const;
+
+    // Returns the slot a key with this hash goes to with this pilot
+    unsigned SlotOf(unsigned long long Hash, unsigned Pilot) const;
+
+    // Releases everything that was allocated
+    void Free();
+
+    mutable OAHTStats Stats_;
+
+    unsigned long long Seed_; //!< Seed of the key hash that gave every bucket a pilot
+    unsigned BucketCount_;    //!< Number of buckets
+    unsigned* Pilots_;        //!< The pilot of each bucket
+    unsigned* KeyOffsets_;    //!< Offset of each slot's key in Keys_
+    T* Data_;                 //!< Client data of each slot
+    char* Keys_;              //!< Every key, NUL-terminated, in slot order
+    size_t KeysSize_;         //!< Bytes in Keys_
+};
+
+#include "PerfectHashTable.cpp"
+
+#endif
@@ -1,77 +1,138 @@
-/*********************************************************/
-/* C Modification of primes table                        */
-/* TDPrimes.INC                                          */
-/* Copyright (c) Julian M Bucknall 1997, 2001            */
-/* All rights reserved.                                  */
-/*********************************************************/
-/* Prime number array include file (auto-generated)      */
-/* This will find prime numbers up to about 16.8 million */
-/*********************************************************/
+#include "Support.h"
 
-#include <cmath>
+/*
+  Deterministic Miller-Rabin. Bases 2, 7 and 61 catch every composite
+  below 4,759,123,141, so below 2^32 "probably prime" is "prime". Products
+  of two values below 2^32 fit in 64 bits, so no 128-bit math is needed.
+*/
+static constexpr unsigned PowMod(unsigned Base, unsigned Exponent, unsigned Modulus)
+{
+  unsigned long long result = 1;
+  unsigned long long base = Base % Modulus;
+  while (Exponent)
+  {
+    if (Exponent & 1)
+      result = result * base % Modulus;
+    base = base * base % Modulus;
+    Exponent >>= 1;
+  }
+  return static_cast<unsigned>(result);
+}
+
+// True if Value (odd, > Base) passes the strong probable prime test to Base
+static constexpr bool IsStrongProbablePrime(unsigned Value, unsigned Base)
+{
+  unsigned odd = Value - 1;
+  unsigned twos = 0;
+  while (!(odd & 1))
+  {
+    odd >>= 1;
+    twos++;
+  }
 
-const unsigned Primes[] = {
-        2,    3,    5,    7,   11,   13,   17,   19,   23,   29, 
-       31,   37,   41,   43,   47,   53,   59,   61,   67,   71, 
-       73,   79,   83,   89,   97,  101,  103,  107,  109,  113, 
-      127,  131,  137,  139,  149,  151,  157,  163,  167,  173, 
-      179,  181,  191,  193,  197,  199,  211,  223,  227,  229, 
-      233,  239,  241,  251,  257,  263,  269,  271,  277,  281, 
-      283,  293,  307,  311,  313,  317,  331,  337,  347,  349, 
-      353,  359,  367,  373,  379,  383,  389,  397,  401,  409, 
-      419,  421,  431,  433,  439,  443,  449,  457,  461,  463, 
-      467,  479,  487,  491,  499,  503,  509,  521,  523,  541, 
-      547,  557,  563,  569,  571,  577,  587,  593,  599,  601, 
-      607,  613,  617,  619,  631,  641,  643,  647,  653,  659, 
-      661,  673,  677,  683,  691,  701,  709,  719,  727,  733, 
-      739,  743,  751,  757,  761,  769,  773,  787,  797,  809, 
-      811,  821,  823,  827,  829,  839,  853,  857,  859,  863, 
-      877,  881,  883,  887,  907,  911,  919,  929,  937,  941, 
-      947,  953,  967,  971,  977,  983,  991,  997, 1009, 1013, 
-     1019, 1021, 1031, 1033, 1039, 1049, 1051, 1061, 1063, 1069, 
-     1087, 1091, 1093, 1097, 1103, 1109, 1117, 1123, 1129, 1151, 
-     1153, 1163, 1171, 1181, 1187, 1193, 1201, 1213, 1217, 1223, 
-     1229, 1231, 1237, 1249, 1259, 1277, 1279, 1283, 1289, 1291, 
-     1297, 1301, 1303, 1307, 1319, 1321, 1327, 1361, 1367, 1373, 
-     1381, 1399, 1409, 1423, 1427, 1429, 1433, 1439, 1447, 1451, 
-     1453, 1459, 1471, 1481, 1483, 1487, 1489, 1493, 1499, 1511, 
-     1523, 1531, 1543, 1549, 1553, 1559, 1567, 1571, 1579, 1583, 
-     1597, 1601, 1607, 1609, 1613, 1619, 1621, 1627, 1637, 1657, 
-     1663, 1667, 1669, 1693, 1697, 1699, 1709, 1721, 1723, 1733, 
-     1741, 1747, 1753, 1759, 1777, 1783, 1787, 1789, 1801, 1811, 
-     1823, 1831, 1847, 1861, 1867, 1871, 1873, 1877, 1879, 1889, 
-     1901, 1907, 1913, 1931, 1933, 1949, 1951, 1973, 1979, 1987, 
-     1993, 1997, 1999, 2003, 2011, 2017, 2027, 2029, 2039, 2053, 
-     2063, 2069, 2081, 2083, 2087, 2089, 2099, 2111, 2113, 2129, 
-     2131, 2137, 2141, 2143, 2153, 2161, 2179, 2203, 2207, 2213, 
-     2221, 2237, 2239, 2243, 2251, 2267, 2269, 2273, 2281, 2287, 
-     2293, 2297, 2309, 2311, 2333, 2339, 2341, 2347, 2351, 2357, 
-     2371, 2377, 2381, 2383, 2389, 2393, 2399, 2411, 2417, 2423, 
-     2437, 2441, 2447, 2459, 2467, 2473, 2477, 2503, 2521, 2531, 
-     2539, 2543, 2549, 2551, 2557, 2579, 2591, 2593, 2609, 2617, 
-     2621, 2633, 2647, 2657, 2659, 2663, 2671, 2677, 2683, 2687, 
-     2689, 2693, 2699, 2707, 2711, 2713, 2719, 2729, 2731, 2741, 
-     2749, 2753, 2767, 2777, 2789, 2791, 2797, 2801, 2803, 2819, 
-     2833, 2837, 2843, 2851, 2857, 2861, 2879, 2887, 2897, 2903, 
-     2909, 2917, 2927, 2939, 2953, 2957, 2963, 2969, 2971, 2999, 
-     3001, 3011, 3019, 3023, 3037, 3041, 3049, 3061, 3067, 3079, 
-     3083, 3089, 3109, 3119, 3121, 3137, 3163, 3167, 3169, 3181, 
-     3187, 3191, 3203, 3209, 3217, 3221, 3229, 3251, 3253, 3257, 
-     3259, 3271, 3299, 3301, 3307, 3313, 3319, 3323, 3329, 3331, 
-     3343, 3347, 3359, 3361, 3371, 3373, 3389, 3391, 3407, 3413, 
-     3433, 3449, 3457, 3461, 3463, 3467, 3469, 3491, 3499, 3511, 
-     3517, 3527, 3529, 3533, 3539, 3541, 3547, 3557, 3559, 3571, 
-     3581, 3583, 3593, 3607, 3613, 3617, 3623, 3631, 3637, 3643, 
-     3659, 3671, 3673, 3677, 3691, 3697, 3701, 3709, 3719, 3727, 
-     3733, 3739, 3761, 3767, 3769, 3779, 3793, 3797, 3803, 3821, 
-     3823, 3833, 3847, 3851, 3853, 3863, 3877, 3881, 3889, 3907, 
-     3911, 3917, 3919, 3923, 3929, 3931, 3943, 3947, 3967, 3989, 
-     4001, 4003, 4007, 4013, 4019, 4021, 4027, 4049, 4051, 4057, 
-     4073, 4079, 4091, 4093, 4099
+  unsigned long long x = PowMod(Base, odd, Value);
+  if (x == 1 || x == Value - 1)
+    return true;
+  for (unsigned i = 1; i < twos; i++)
+  {
+    x = x * x % Value;
+    if (x == Value - 1)
+      return true;
+  }
+  return false;
+}
+
+static constexpr bool IsPrimeValue(unsigned Value)
+{
+    // Small factors first, which also covers the bases themselves
+  const unsigned small[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61};
+  for (unsigned i = 0; i < sizeof(small) / sizeof(*small); i++)
+  {
+    if (Value % small[i] == 0)
+      return Value == small[i];
+  }
+  if (Value < 67 * 67)
+    return Value > 1;
+
+  return IsStrongProbablePrime(Value, 2) && IsStrongProbablePrime(Value, 7) &&
+         IsStrongProbablePrime(Value, 61);
+}
+
+/*
+  Table sizes for growing by anything from about 1.1x to 2x: each prime is
+  the first one at least 10% past the one before, up to the largest 32-bit
+  prime. Each entry's fastmod reciprocal is worked out by the compiler.
+*/
+static constexpr FastModulus PrimeLadder[] = {
+    FastModulus(7), FastModulus(11), FastModulus(13), FastModulus(17), FastModulus(19),
+    FastModulus(23), FastModulus(29), FastModulus(37), FastModulus(41), FastModulus(47),
+    FastModulus(53), FastModulus(59), FastModulus(67), FastModulus(79), FastModulus(89),
+    FastModulus(101), FastModulus(113), FastModulus(127), FastModulus(149), FastModulus(167),
+    FastModulus(191), FastModulus(211), FastModulus(233), FastModulus(257), FastModulus(283),
+    FastModulus(313), FastModulus(347), FastModulus(383), FastModulus(431), FastModulus(479),
+    FastModulus(541), FastModulus(599), FastModulus(659), FastModulus(727), FastModulus(809),
+    FastModulus(907), FastModulus(1009), FastModulus(1117), FastModulus(1229), FastModulus(1361),
+    FastModulus(1499), FastModulus(1657), FastModulus(1823), FastModulus(2011), FastModulus(2213),
+    FastModulus(2437), FastModulus(2683), FastModulus(2953), FastModulus(3251), FastModulus(3581),
+    FastModulus(3943), FastModulus(4339), FastModulus(4783), FastModulus(5273), FastModulus(5801),
+    FastModulus(6389), FastModulus(7039), FastModulus(7753), FastModulus(8537), FastModulus(9391),
+    FastModulus(10331), FastModulus(11369), FastModulus(12511), FastModulus(13763),
+    FastModulus(15149), FastModulus(16673), FastModulus(18341), FastModulus(20177),
+    FastModulus(22229), FastModulus(24469), FastModulus(26921), FastModulus(29629),
+    FastModulus(32603), FastModulus(35869), FastModulus(39461), FastModulus(43411),
+    FastModulus(47777), FastModulus(52561), FastModulus(57829), FastModulus(63617),
+    FastModulus(69991), FastModulus(76991), FastModulus(84691), FastModulus(93169),
+    FastModulus(102497), FastModulus(112757), FastModulus(124067), FastModulus(136481),
+    FastModulus(150131), FastModulus(165161), FastModulus(181693), FastModulus(199873),
+    FastModulus(219871), FastModulus(241861), FastModulus(266051), FastModulus(292661),
+    FastModulus(321947), FastModulus(354143), FastModulus(389561), FastModulus(428531),
+    FastModulus(471389), FastModulus(518533), FastModulus(570389), FastModulus(627433),
+    FastModulus(690187), FastModulus(759223), FastModulus(835207), FastModulus(918733),
+    FastModulus(1010617), FastModulus(1111687), FastModulus(1222889), FastModulus(1345207),
+    FastModulus(1479733), FastModulus(1627723), FastModulus(1790501), FastModulus(1969567),
+    FastModulus(2166529), FastModulus(2383219), FastModulus(2621551), FastModulus(2883733),
+    FastModulus(3172123), FastModulus(3489347), FastModulus(3838283), FastModulus(4222117),
+    FastModulus(4644329), FastModulus(5108767), FastModulus(5619667), FastModulus(6181639),
+    FastModulus(6799811), FastModulus(7479803), FastModulus(8227787), FastModulus(9050599),
+    FastModulus(9955697), FastModulus(10951273), FastModulus(12046403), FastModulus(13251047),
+    FastModulus(14576161), FastModulus(16033799), FastModulus(17637203), FastModulus(19400929),
+    FastModulus(21341053), FastModulus(23475161), FastModulus(25822679), FastModulus(28404989),
+    FastModulus(31245491), FastModulus(34370053), FastModulus(37807061), FastModulus(41587807),
+    FastModulus(45746593), FastModulus(50321261), FastModulus(55353391), FastModulus(60888739),
+    FastModulus(66977621), FastModulus(73675391), FastModulus(81042947), FastModulus(89147249),
+    FastModulus(98061979), FastModulus(107868203), FastModulus(118655027), FastModulus(130520531),
+    FastModulus(143572609), FastModulus(157929907), FastModulus(173722907), FastModulus(191095213),
+    FastModulus(210204763), FastModulus(231225257), FastModulus(254347801), FastModulus(279782593),
+    FastModulus(307760897), FastModulus(338536987), FastModulus(372390691), FastModulus(409629809),
+    FastModulus(450592801), FastModulus(495652109), FastModulus(545217341), FastModulus(599739083),
+    FastModulus(659713007), FastModulus(725684317), FastModulus(798252779), FastModulus(878078057),
+    FastModulus(965885863), FastModulus(1062474559), FastModulus(1168722059),
+    FastModulus(1285594279), FastModulus(1414153729), FastModulus(1555569107),
+    FastModulus(1711126033), FastModulus(1882238639), FastModulus(2070462533),
+    FastModulus(2277508787), FastModulus(2505259681), FastModulus(2755785653),
+    FastModulus(3031364227), FastModulus(3334500667), FastModulus(3667950739),
+    FastModulus(4034745863), FastModulus(4294967291),
 };
 
-const unsigned PrimeCount = sizeof(Primes) / sizeof(*Primes);
-const unsigned MaxPrime = 4099;
+const unsigned PrimeLadderCount = sizeof(PrimeLadder) / sizeof(*PrimeLadder);
+
+static constexpr bool IsLadderPrime()
+{
+  for (unsigned i = 0; i < PrimeLadderCount; i++)
+  {
+    if (!IsPrimeValue(PrimeLadder[i].Divisor_))
+      return false;
+    if (i && PrimeLadder[i].Divisor_ <= PrimeLadder[i - 1].Divisor_)
+      return false;
+  }
+  return PrimeLadder[PrimeLadderCount - 1].Divisor_ == MAX_PRIME;
+}
+static_assert(IsLadderPrime(), "The prime ladder must be increasing primes up to MAX_PRIME");
+
+bool IsPrime(unsigned Value)
+{
+  return IsPrimeValue(Value);
+}
 
 unsigned GetClosestPrime(unsigned Value)
 {
@@ -79,65 +140,43 @@ unsigned GetClosestPrime(unsigned Value)
   if (Value < 4)
     return Value;
 
-    // Make sure our starting value is odd    
-  unsigned prime;
-  if (Value % 2)
-    prime = Value;
-  else
-    prime = Value + 1;
-
-    //if the result is within our prime number table, use binary search
-    // to find the equal or next highest prime number
-  unsigned L, R, M;
-  if (prime <= MaxPrime)
-  {
-    L = 0;
-    R = PrimeCount - 1;
-    while (L <= R) 
-    {
-      M = (L + R) / 2;
-      if (prime == Primes[M])
-        return prime;
-      else if (prime < Primes[M])
-        R = M - 1;
-      else
-        L = M + 1;
-    }
-    prime = Primes[L];
-    return prime;
-  }
+    // Nothing bigger fits in 32 bits
+  if (Value >= MAX_PRIME)
+    return MAX_PRIME;
 
+    // Make sure our starting value is odd, then try every odd value after
+    // it. Gaps between primes below 2^32 are at most 336, so this stops
+    // after a few dozen tests at worst.
+  unsigned prime = Value | 1;
+  while (!IsPrimeValue(prime))
+    prime += 2;
+  return prime;
+}
 
-    /* the result is outside our prime number table range, use the
-       standard method for testing primality (do any of the primes up to
-       the root of the number divide it exactly?) and continue
-      incrementing the result by 2 until it is prime
-    */
-  if (prime <= MaxPrime * MaxPrime)
+const FastModulus& GetLadderPrime(unsigned Value)
+{
+    // First entry >= Value (binary search)
+  unsigned L = 0;
+  unsigned R = PrimeLadderCount - 1;
+  while (L < R)
   {
-    bool run = true;
-    while (run)
-    {
-      unsigned RootN = static_cast<unsigned>(std::sqrt((double)prime));
-      unsigned DivisorIndex = 1;
-      bool IsPrime = true;
-      while ((DivisorIndex < PrimeCount) && (RootN > Primes[DivisorIndex]))
-      {
-        if ( ((prime / Primes[DivisorIndex]) * Primes[DivisorIndex]) == prime )
-        {
-          IsPrime = false;
-          break;
-        }
-        DivisorIndex++;
-      }
-      if (IsPrime)
-        return prime;
-      
-      prime += 2;
-
-    }
+    unsigned M = (L + R) / 2;
+    if (PrimeLadder[M].Divisor_ < Value)
+      L = M + 1;
+    else
+      R = M;
   }
-  return prime;
+  return PrimeLadder[L];
 }
 
-
+unsigned GetNextPowerOfTwo(unsigned Value)
+{
+    // Smear the highest set bit of Value - 1 into every lower bit
+  unsigned power = Value ? Value - 1 : 0;
+  power |= power >> 1;
+  power |= power >> 2;
+  power |= power >> 4;
+  power |= power >> 8;
+  power |= power >> 16;
+  return power + 1;
+}
@@ -3,6 +3,40 @@
 #define SUPPORTH
 //---------------------------------------------------------------------------
 
+//! Largest prime that fits in 32 bits
+const unsigned MAX_PRIME = 4294967291u;
+
+// Returns the smallest prime >= Value (Value itself below 4, MAX_PRIME
+// above it)
 unsigned GetClosestPrime(unsigned Value);
+unsigned GetNextPowerOfTwo(unsigned Value);
+
+// Returns true if Value is prime
+bool IsPrime(unsigned Value);
+
+//! Precomputed reciprocal that turns "Value % Divisor" into two multiplies
+struct FastModulus
+{
+    //! Non-default constructor
+    constexpr FastModulus(unsigned Divisor = 1)
+        : Divisor_(Divisor), Multiplier_(~0ULL / (Divisor ? Divisor : 1) + 1){};
+
+    //! Returns Value % Divisor_ (Lemire's fastmod)
+    unsigned Reduce(unsigned Value) const
+    {
+        // The high 64 bits of the 96-bit product (Multiplier_ * Value) * Divisor_
+        unsigned long long fraction = Multiplier_ * Value;
+        unsigned long long high = (fraction >> 32) * Divisor_;
+        unsigned long long low = (fraction & 0xffffffffULL) * Divisor_;
+        return static_cast<unsigned>((high + (low >> 32)) >> 32);
+    }
+
+    unsigned Divisor_;              //!< The value reduced by
+    unsigned long long Multiplier_; //!< ceil(2^64 / Divisor_)
+};
+
+// Returns the first prime of a ladder of primes about 10% apart that is
+// >= Value (MAX_PRIME's, above it), with its reciprocal already worked out
+const FastModulus& GetLadderPrime(unsigned Value);
 
 #endif
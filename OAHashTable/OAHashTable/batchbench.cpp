@@ -0,0 +1,77 @@
+// Compares find in a loop against find_batch on a table much larger than
+// the last level cache. Build with "make -f Makefile2 batchbench" and pass
+// the number of keys (default 4 million) on the command line.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "HashFuncs.h"
+#include "OAHashTable.h"
+
+typedef OAHashTable<unsigned> Table;
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = 4000000;
+    if (argc > 1)
+        count = static_cast<size_t>(std::atol(argv[1]));
+
+    // Keys and their data
+    std::vector<std::string> strings(count);
+    std::vector<const char*> keys(count);
+    std::vector<unsigned> data(count);
+    char buffer[32];
+    for (size_t i = 0; i < count; i++)
+    {
+        std::sprintf(buffer, "key-%zu", i);
+        strings[i] = buffer;
+        keys[i] = strings[i].c_str();
+        data[i] = static_cast<unsigned>(i);
+    }
+
+    Table ht(Table::OAHTConfig(1009, WyHash, 0, 0.5, 2.0, PACK));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ht.insert_batch(&keys[0], &data[0], count);
+    double seconds = Seconds(start);
+
+    size_t bytes = ht.GetStats().TableSize_ * sizeof(Table::OAHTSlot);
+    std::printf(
+        "%zu keys, %u slots (%zu MB of slots), built in %.2f s\n",
+        count,
+        ht.GetStats().TableSize_,
+        bytes >> 20,
+        seconds);
+
+    // Look the keys up in random order so every lookup misses the cache
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+
+    unsigned long long sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+        sum += ht.find(keys[i]);
+    double single = Seconds(start);
+
+    std::vector<const unsigned*> found(count);
+    unsigned long long batchSum = 0;
+    start = std::chrono::steady_clock::now();
+    ht.find_batch(&keys[0], count, &found[0]);
+    for (size_t i = 0; i < count; i++)
+        batchSum += *found[i];
+    double batch = Seconds(start);
+
+    if (sum != batchSum)
+        std::printf("MISMATCH: %llu != %llu\n", sum, batchSum);
+
+    std::printf("find:       %7.1f ns/lookup\n", single * 1e9 / static_cast<double>(count));
+    std::printf("find_batch: %7.1f ns/lookup\n", batch * 1e9 / static_cast<double>(count));
+    return 0;
+}
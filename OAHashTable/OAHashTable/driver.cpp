@@ -1,3 +1,5 @@
+#include <atomic>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -5,6 +7,9 @@
 #include <iostream>
 using namespace std;
 
+#include "CuckooHashTable.h"
+#include "PerfectHashTable.h"
+#include "HashFuncs.h"
 #include "OAHashTable.h"
 
 const unsigned ID_LEN = 6;
@@ -105,16 +110,6 @@ ostream& operator<<(ostream& os, const Person& person)
     return os;
 }
 
-unsigned ConstantHash(const char*, unsigned)
-{
-    return 1;
-}
-
-unsigned ReflexiveHash(const char* Key, unsigned TableSize)
-{
-    return static_cast<unsigned>(atoi(Key)) % TableSize;
-}
-
 void RevString(char* Key)
 {
     unsigned len = static_cast<unsigned>(strlen(Key));
@@ -126,108 +121,6 @@ void RevString(char* Key)
     }
 }
 
-unsigned PJWHash(const char* Key, unsigned TableSize)
-{
-    // Initial value of hash
-    unsigned hash = 0;
-
-    // Process each char in the string
-    while (*Key)
-    {
-        // Shift hash left 4
-        hash = (hash << 4);
-
-        // Add in current char
-        hash = hash + static_cast<unsigned>((*Key));
-
-        // Get the four high-order bits
-        unsigned bits = hash & 0xF0000000;
-
-        // If any of the four bits are non-zero,
-        if (bits)
-        {
-            // Shift the four bits right 24 positions (...bbbb0000)
-            // and XOR them back in to the hash
-            hash = hash ^ (bits >> 24);
-
-            // Now, XOR the four bits back in
-            hash = hash ^ bits;
-        }
-
-        // Next char
-        Key++;
-    }
-
-    // Modulo so hash is within 0 - TableSize
-    return hash % TableSize;
-}
-
-unsigned SimpleHash(const char* Key, unsigned TableSize)
-{
-    // Initial value of hash
-    unsigned hash = 0;
-
-    // Process each char in the string
-    while (*Key)
-    {
-        // Add in current char
-        hash += static_cast<unsigned>(*Key);
-
-        // Next char
-        Key++;
-    }
-
-    // Modulo so hash is within the table
-    return hash % TableSize;
-}
-
-unsigned RSHash(const char* Key, unsigned TableSize)
-{
-    unsigned hash = 0;         // Initial value of hash
-    unsigned multiplier = 127; // Prevent anomalies
-
-    // Process each char in the string
-    while (*Key)
-    {
-        // Adjust hash total
-        hash = hash * multiplier;
-
-        // Add in current char and mod result
-        hash = (hash + static_cast<unsigned>(*Key)) % TableSize;
-
-        // Next char
-        Key++;
-    }
-
-    // Hash is within 0 - TableSize
-    return hash;
-}
-
-unsigned UHash(const char* Key, unsigned TableSize)
-{
-    unsigned hash = 0;      // Initial value of hash
-    unsigned rand1 = 31415; // "Random" 1
-    unsigned rand2 = 27183; // "Random" 2
-
-    // Process each char in string
-    while (*Key)
-    {
-        // Multiply hash by random
-        hash = hash * rand1;
-
-        // Add in current char, keep within TableSize
-        hash = (hash + static_cast<unsigned>(*Key)) % TableSize;
-
-        // Update rand1 for next "random" number
-        rand1 = (rand1 * rand2) % (TableSize - 1);
-
-        // Next char
-        Key++;
-    }
-    // Hash value is within 0 - TableSize - 1
-    return hash;
-}
-
 struct HashData
 {
     HASHFUNC Fn;
@@ -242,7 +135,9 @@ enum HASHFUNCS
     SIMPLE,
     RS,
     UNIVERSAL,
-    PJW
+    PJW,
+    WY,
+    XX
 };
 
 HashData HashingFuncs[] = {
@@ -252,7 +147,9 @@ HashData HashingFuncs[] = {
     {SimpleHash, "Simple Hash"},
     {RSHash, "RS Hash"},
     {UHash, "Universal Hash"},
-    {PJWHash, "PJW Hash"}};
+    {PJWHash, "PJW Hash"},
+    {WyHash, "Wy Hash"},
+    {XXHash, "XX Hash"}};
 
 void Dispose(Person*)
 {
@@ -275,16 +172,16 @@ void DumpTable(OAHashTable<T>& ht)
                     buffer,
                     "Slot: %3d, Key: %s (%d)\n",
                     i,
-                    slot->Key,
-                    phf(slot->Key, ht.GetStats().TableSize_));
+                    ht.GetKey(*slot),
+                    phf(ht.GetKey(*slot), ht.GetStats().TableSize_));
             else
                 sprintf(
                     buffer,
                     "Slot: %3d, Key: %s (%d:%d)\n",
                     i,
-                    slot->Key,
-                    phf(slot->Key, ht.GetStats().TableSize_),
-                    shf(slot->Key, ht.GetStats().TableSize_ - 1) + 1);
+                    ht.GetKey(*slot),
+                    phf(ht.GetKey(*slot), ht.GetStats().TableSize_),
+                    shf(ht.GetKey(*slot), ht.GetStats().TableSize_ - 1) + 1);
             cout << buffer;
         }
         else if (slot->State == OAHashTable<T>::OAHTSlot::DELETED)
@@ -300,14 +197,53 @@ void DumpTable(OAHashTable<T>& ht)
     }
 }
 
+void DumpStats(const OAHTStats& stats, ostream& os = cout)
+{
+    os << "Number of probes: " << stats.Probes_ << endl;
+    os << "Number of expansions: " << stats.Expansions_ << endl;
+    os << "Items: " << stats.Count_ << ", TableSize: " << stats.TableSize_ << endl;
+    os << "Load factor: " << setprecision(3)
+       << (double)stats.Count_ / (double)stats.TableSize_ << endl;
+}
+
 template <typename T>
 void DumpStats(OAHashTable<T>& ht, ostream& os = cout)
 {
-    os << "Number of probes: " << ht.GetStats().Probes_ << endl;
-    os << "Number of expansions: " << ht.GetStats().Expansions_ << endl;
-    os << "Items: " << ht.GetStats().Count_ << ", TableSize: " << ht.GetStats().TableSize_ << endl;
-    os << "Load factor: " << setprecision(3)
-       << (double)ht.GetStats().Count_ / (double)ht.GetStats().TableSize_ << endl;
+    DumpStats(ht.GetStats(), os);
+}
+
+// Prints the non-empty buckets of a histogram as probes:count
+void DumpHistogram(const char* name, const unsigned* histogram, ostream& os = cout)
+{
+    os << setw(13) << left << name << right;
+    for (unsigned i = 0; i < PROBE_HISTOGRAM_SIZE; i++)
+    {
+        if (histogram[i])
+        {
+            os << " " << i + 1;
+            if (i == PROBE_HISTOGRAM_SIZE - 1)
+                os << "+";
+            os << ":" << histogram[i];
+        }
+    }
+    os << endl;
+}
+
+void DumpProfile(const OAHTProfile& profile, ostream& os = cout)
+{
+    DumpHistogram("Find hits:", profile.FindHits_, os);
+    DumpHistogram("Find misses:", profile.FindMisses_, os);
+    DumpHistogram("Inserts:", profile.Inserts_, os);
+    DumpHistogram("Removes:", profile.Removes_, os);
+    os << "Longest cluster: " << profile.LongestCluster_ << endl;
+    for (size_t i = 0; i < profile.Growth_.size(); i++)
+    {
+        const OAHTGrowth& growth = profile.Growth_[i];
+        os << "Grew from " << growth.OldSize_ << " to " << growth.NewSize_ << " at "
+           << growth.Count_ << " items (load factor " << setprecision(3)
+           << (double)growth.Count_ / (double)growth.OldSize_ << "), " << growth.Probes_
+           << " probes" << endl;
+    }
 }
 
 void TestALot(HashData* phd, HashData* shd)
@@ -1021,6 +957,560 @@ void TestSimpleMarkPack(HashData* phd, HashData* shd, OAHTDeletionPolicy policy)
     }
 }
 
+// Integer keys, and string view keys with the default hash
+void TestTemplatedKeys()
+{
+    cout << endl << "==================== TestTemplatedKeys ====================" << endl;
+
+    unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+
+    typedef OAHashTable<unsigned, Person*> IntMap;
+    IntMap ht(IntMap::OAHTConfig(7, true, 0.75, 2.0, MARK));
+    try
+    {
+        for (unsigned i = 0; i < count; i++)
+            ht.insert(static_cast<unsigned>(atoi(PersonRecs[i]->ID)), PersonRecs[i]);
+
+        cout << *ht.find(106001) << endl;
+        ht.remove(106001);
+        ht.find(106001);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+    DumpStats(ht.GetStats());
+    cout << endl;
+
+    typedef OAHashTable<OAHTStringRef, Person*> StringMap;
+    StringMap sht(StringMap::OAHTConfig(7, false, 0.75, 2.0, PACK));
+    try
+    {
+        for (unsigned i = 0; i < count; i++)
+            sht.insert(PersonRecs[i]->ID, PersonRecs[i]);
+
+        cout << *sht.find("123001") << endl;
+        sht.insert("123001", PersonRecs[0]);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+    DumpStats(sht.GetStats());
+}
+
+void TestBatch()
+{
+    cout << endl << "==================== TestBatch ====================" << endl;
+
+    typedef Person* T;
+    OAHashTable<T> ht(OAHashTable<T>::OAHTConfig(7, PJWHash, 0, 0.75, 2.0, PACK, 0));
+
+    unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+    const char* keys[sizeof(PEOPLE) / sizeof(*PEOPLE) + 2];
+    for (unsigned i = 0; i < count; i++)
+        keys[i] = PersonRecs[i]->ID;
+
+    try
+    {
+        ht.insert_batch(keys, PersonRecs, count);
+        DumpStats<T>(ht);
+
+        // Every other key, plus a couple that aren't there
+        const char* lookup[] = {keys[0], "999999", keys[2], keys[4], "123456", keys[22]};
+        const T* found[sizeof(lookup) / sizeof(*lookup)];
+        ht.find_batch(lookup, sizeof(lookup) / sizeof(*lookup), found);
+        for (unsigned i = 0; i < sizeof(lookup) / sizeof(*lookup); i++)
+        {
+            if (found[i])
+                cout << **found[i] << endl;
+            else
+                cout << "Key " << lookup[i] << " not found." << endl;
+        }
+        DumpStats<T>(ht);
+
+        // A duplicate stops the batch
+        ht.insert_batch(keys + 5, PersonRecs + 5, 1);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+void TestSizing(OAHTSizingPolicy sizing)
+{
+    cout << endl << "==================== TestSizing ====================" << endl;
+
+    const char* names[] = {"PRIME", "PRIME_FASTMOD", "POWER_OF_TWO"};
+    cout << "Sizing policy: " << names[sizing] << endl;
+
+    typedef Person* T;
+    OAHashTable<T> ht(
+        OAHashTable<T>::OAHTConfig(5, SimpleHash, PJWHash, 0.75, 2.0, MARK, 0, sizing));
+    try
+    {
+        unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+        for (unsigned i = 0; i < count; i++)
+            ht.insert(PersonRecs[i]->ID, PersonRecs[i]);
+        DumpStats<T>(ht);
+
+        for (unsigned i = 0; i < count; i += 2)
+            ht.remove(PersonRecs[i]->ID);
+        cout << *ht.find("104001") << endl;
+        DumpStats<T>(ht);
+
+        ht.find("103001");
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Churn (remove one key, insert another) on a MARK table and look at how
+// long the probe sequences get with and without tombstone rehashing
+void TestTombstones(double max_deleted_factor)
+{
+    cout << endl << "==================== TestTombstones ====================" << endl;
+    cout << "Max deleted factor: " << max_deleted_factor << endl;
+
+    typedef unsigned T;
+    OAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+        53, PJWHash, 0, 0.75, 2.0, MARK, 0, PRIME, max_deleted_factor));
+    try
+    {
+        char key[16];
+        const unsigned live = 30;
+        for (unsigned i = 0; i < live; i++)
+        {
+            sprintf(key, "k%u", i);
+            ht.insert(key, i);
+        }
+        for (unsigned i = live; i < 1000; i++)
+        {
+            sprintf(key, "k%u", i - live);
+            ht.remove(key);
+            sprintf(key, "k%u", i);
+            ht.insert(key, i);
+        }
+
+        OAHTStats stats = ht.GetStats();
+        cout << "Tombstones: " << stats.Deleted_ << ", Rehashes: " << stats.Rehashes_ << endl;
+        DumpStats(stats);
+
+        unsigned probes = stats.Probes_;
+        for (unsigned i = 0; i < 1000; i++)
+        {
+            sprintf(key, "x%u", i);
+            try
+            {
+                ht.find(key);
+            }
+            catch (OAHashTableException&)
+            {
+            }
+        }
+        cout << "Probes for 1000 failed finds: " << ht.GetStats().Probes_ - probes << endl;
+
+        ht.rehash();
+        stats = ht.GetStats();
+        cout << "After rehash(), Tombstones: " << stats.Deleted_
+             << ", Rehashes: " << stats.Rehashes_ << endl;
+        cout << ht.find("k999") << endl;
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Homes and strides (less 1) for TestRehashStride. In a table of 64 slots,
+// X only visits slots 10 and 42, and B steps down from 42.
+unsigned StrideTestHome(const char* Key, unsigned)
+{
+    return *Key == 'B' ? 42 : 10;
+}
+
+unsigned StrideTestStep(const char* Key, unsigned)
+{
+    return *Key == 'X' ? 31 : *Key == 'B' ? 62 : 0;
+}
+
+// A lands in slot 10, so X goes on to 42 and B goes on to 41. rehash() then
+// places B in 42 before it gets to X, which leaves X nowhere to go until the
+// table grows.
+void TestRehashStride()
+{
+    cout << endl << "==================== TestRehashStride ====================" << endl;
+
+    typedef unsigned T;
+    OAHashTable<T> ht(
+        OAHashTable<T>::OAHTConfig(64, StrideTestHome, StrideTestStep, 0.9, 2.0, MARK, 0));
+    try
+    {
+        ht.insert("A", 1);
+        ht.insert("X", 2);
+        ht.insert("B", 3);
+        ht.rehash();
+        cout << "A: " << ht.find("A") << ", X: " << ht.find("X") << ", B: " << ht.find("B")
+             << endl;
+        DumpStats<T>(ht);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Saves a table, maps it back in and looks things up in it
+void TestSnapshot()
+{
+    cout << endl << "==================== TestSnapshot ====================" << endl;
+
+    typedef unsigned T;
+    const char* path = "people.oaht";
+    OAHashTable<T>::OAHTConfig config(7, PJWHash, SimpleHash, 0.75, 2.0, MARK);
+    unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+    try
+    {
+        OAHashTable<T> ht(config);
+        for (unsigned i = 0; i < count; i++)
+            ht.insert(PEOPLE[i].ID, PEOPLE[i].years);
+        ht.remove("105001");
+        ht.save(path);
+
+        OAHashTable<T> mapped(config);
+        mapped.load_mapped(path);
+        DumpStats<T>(mapped);
+        cout << "Years of 109001: " << mapped.find("109001") << endl;
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            try
+            {
+                if (mapped.find(PEOPLE[i].ID) != ht.find(PEOPLE[i].ID))
+                    cout << "Wrong data for " << PEOPLE[i].ID << endl;
+            }
+            catch (OAHashTableException& e)
+            {
+                cout << PEOPLE[i].ID << ": " << e.what() << endl;
+            }
+        }
+
+        try
+        {
+            mapped.insert("124001", 1);
+        }
+        catch (OAHashTableException& e)
+        {
+            cout << "errno: " << e.code() << ", " << e.what() << endl;
+        }
+
+        mapped.make_writable();
+        mapped.insert("124001", 1);
+        mapped.remove("101001");
+        DumpStats<T>(mapped);
+
+        // The same file with a state no table writes in its first slot (the
+        // slots start after the 64-byte header)
+        std::FILE* file = std::fopen(path, "rb");
+        std::vector<char> bytes;
+        for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file))
+            bytes.push_back(static_cast<char>(c));
+        std::fclose(file);
+        bytes[64 + offsetof(OAHashTable<T>::OAHTSlot, State)] = 7;
+        const char* damaged = "damaged.oaht";
+        file = std::fopen(damaged, "wb");
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+        try
+        {
+            OAHashTable<T> broken(config);
+            broken.load_mapped(damaged);
+        }
+        catch (OAHashTableException& e)
+        {
+            cout << "errno: " << e.code() << ", " << e.what() << endl;
+        }
+        std::remove(damaged);
+
+        OAHashTable<T> other(OAHashTable<T>::OAHTConfig(7, UHash, SimpleHash, 0.75, 2.0, MARK));
+        other.load_mapped(path);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+    std::remove(path);
+}
+
+// Probe length histograms and growth of an instrumented table
+void TestProfile(HashData* phd, HashData* shd)
+{
+    cout << endl << "==================== TestProfile ====================" << endl;
+    cout << "Primary hash function: " << phd->Name << endl;
+    cout << "Secondary hash function: " << shd->Name << endl;
+
+    typedef Person* T;
+    OAHashTable<T> ht(OAHashTable<T>::OAHTConfig(
+        7, phd->Fn, shd->Fn, 0.75, 2.0, MARK, 0, PRIME, 0.25, true));
+    try
+    {
+        unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+        for (unsigned i = 0; i < count; i++)
+            ht.insert(PersonRecs[i]->ID, PersonRecs[i]);
+        for (unsigned i = 0; i < count; i++)
+            ht.find(PersonRecs[i]->ID);
+        for (unsigned i = 0; i < count; i += 4)
+            ht.remove(PersonRecs[i]->ID);
+
+        const char* missing[] = {"100001", "124001", "101002", "999999", "110010"};
+        for (unsigned i = 0; i < sizeof(missing) / sizeof(*missing); i++)
+        {
+            try
+            {
+                ht.find(missing[i]);
+            }
+            catch (OAHashTableException&)
+            {
+            }
+        }
+
+        DumpStats<T>(ht);
+        DumpProfile(ht.GetProfile());
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Builds the same table with the bulk constructor and with insert
+void TestBulkBuild(OAHTSizingPolicy sizing)
+{
+    cout << endl << "==================== TestBulkBuild ====================" << endl;
+
+    const char* names[] = {"PRIME", "PRIME_FASTMOD", "POWER_OF_TWO"};
+    cout << "Sizing policy: " << names[sizing] << endl;
+
+    typedef unsigned T;
+    const unsigned count = 20000;
+    char* buffer = new char[count * 8];
+    const char** keys = new const char*[count];
+    T* data = new T[count];
+    for (unsigned i = 0; i < count; i++)
+    {
+        sprintf(buffer + i * 8, "%06u", 100000 + i * 37);
+        keys[i] = buffer + i * 8;
+        data[i] = i;
+    }
+
+    try
+    {
+        OAHashTable<T>::OAHTConfig config(11, PJWHash, SimpleHash, 0.6, 2.0, MARK, 0, sizing);
+        OAHashTable<T> one(config);
+        for (unsigned i = 0; i < count; i++)
+            one.insert(keys[i], data[i]);
+        OAHashTable<T> bulk(config, keys, data, count, 4);
+
+        cout << "insert: " << one.GetStats().Count_ << " items, TableSize "
+             << one.GetStats().TableSize_ << endl;
+        cout << "bulk:   " << bulk.GetStats().Count_ << " items, TableSize "
+             << bulk.GetStats().TableSize_ << endl;
+
+        unsigned mismatches = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (bulk.find(keys[i]) != one.find(keys[i]))
+                mismatches++;
+        }
+        cout << "Finds that differ: " << mismatches << endl;
+
+        // A size that isn't prime, filled up: some keys' strides never reach
+        // a free slot, so the build falls back to inserting one at a time
+        OAHashTable<T>::OAHTConfig full(16, PJWHash, SimpleHash, 1.0, 2.0, MARK, 0, sizing);
+        OAHashTable<T> packed(full, keys, data, 16);
+        mismatches = 0;
+        for (unsigned i = 0; i < 16; i++)
+        {
+            if (packed.find(keys[i]) != data[i])
+                mismatches++;
+        }
+        cout << "full:   " << packed.GetStats().Count_ << " items, TableSize "
+             << packed.GetStats().TableSize_ << ", finds that differ: " << mismatches << endl;
+
+        keys[count - 1] = keys[0];
+        OAHashTable<T> duplicates(config, keys, data, count, 4);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+
+    delete[] data;
+    delete[] keys;
+    delete[] buffer;
+}
+
+// Cuckoo hashing: every find looks at two buckets at most
+void TestCuckoo(HashData* phd, HashData* shd)
+{
+    cout << endl << "==================== TestCuckoo ====================" << endl;
+    cout << "Primary hash function: " << phd->Name << endl;
+    cout << "Secondary hash function: " << shd->Name << endl;
+
+    typedef Person* T;
+    CuckooHashTable<T> ht(CuckooHashTable<T>::OAHTConfig(8, phd->Fn, shd->Fn, 0.9));
+    try
+    {
+        unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+        for (unsigned i = 0; i < count; i++)
+            ht.insert(PersonRecs[i]->ID, PersonRecs[i]);
+        DumpStats(ht.GetStats());
+        cout << "Stash: " << ht.GetStashCount() << endl;
+
+        unsigned probes = ht.GetStats().Probes_;
+        for (unsigned i = 0; i < count; i++)
+            ht.find(PersonRecs[i]->ID);
+        cout << "Buckets looked at by " << count << " finds: " << ht.GetStats().Probes_ - probes
+             << endl;
+
+        for (unsigned i = 0; i < count; i += 2)
+            ht.remove(PersonRecs[i]->ID);
+        cout << *ht.find("104001") << endl;
+        DumpStats(ht.GetStats());
+
+        ht.insert("104001", PersonRecs[0]);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Perfect hashing: one slot per key, and every find looks at one slot
+void TestPerfectHash()
+{
+    cout << endl << "==================== TestPerfectHash ====================" << endl;
+
+    typedef Person* T;
+    OAHashTable<T> ht(OAHashTable<T>::OAHTConfig(7, PJWHash));
+    try
+    {
+        unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+        for (unsigned i = 0; i < count; i++)
+            ht.insert(PersonRecs[i]->ID, PersonRecs[i]);
+
+        PerfectHashTable<T> pht(ht);
+        DumpStats(pht.GetStats());
+        for (unsigned i = 0; i < count; i++)
+            if (pht.find(PersonRecs[i]->ID) != PersonRecs[i])
+                cout << "Wrong item for " << PersonRecs[i]->ID << endl;
+        cout << "Slots looked at by " << count << " finds: " << pht.GetStats().Probes_ << endl;
+        cout << *pht.find("104001") << endl;
+
+        const char* keys[] = {"101001", "102001", "101001"};
+        T data[] = {PersonRecs[0], PersonRecs[1], PersonRecs[2]};
+        try
+        {
+            PerfectHashTable<T> duplicates(keys, data, 3);
+        }
+        catch (OAHashTableException& e)
+        {
+            cout << "errno: " << e.code() << ", " << e.what() << endl;
+        }
+
+        pht.find("999999");
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Walks the items with iterators and with parallel_for_each
+void TestIterate()
+{
+    cout << endl << "==================== TestIterate ====================" << endl;
+
+    typedef Person* T;
+    OAHashTable<T> ht(OAHashTable<T>::OAHTConfig(7, PJWHash, 0, 0.5, 2.0, MARK, 0, PRIME, 0));
+    unsigned count = sizeof(PEOPLE) / sizeof(*PEOPLE);
+    for (unsigned i = 0; i < count; i++)
+        ht.insert(PersonRecs[i]->ID, PersonRecs[i]);
+    for (unsigned i = 0; i < count; i += 3)
+        ht.remove(PersonRecs[i]->ID);
+    DumpStats(ht.GetStats());
+
+    unsigned items = 0;
+    for (OAHashTable<T>::const_iterator it = ht.begin(); it != ht.end(); ++it)
+    {
+        if (it->Data != ht.find(it.key()))
+            cout << "Wrong item for " << it.key() << endl;
+        items++;
+    }
+    cout << "Items iterated: " << items << endl;
+
+    // Enough slots for several threads
+    typedef unsigned U;
+    const unsigned many = 20000;
+    char buffer[8];
+    OAHashTable<U> big(OAHashTable<U>::OAHTConfig(11, PJWHash, SimpleHash, 0.6, 2.0, MARK));
+    for (unsigned i = 0; i < many; i++)
+    {
+        sprintf(buffer, "%06u", 100000 + i * 37);
+        big.insert(buffer, i);
+    }
+
+    unsigned long long expected = 0;
+    for (OAHashTable<U>::const_iterator it = big.begin(); it != big.end(); it++)
+        expected += it->Data;
+
+    std::atomic<unsigned long long> sum(0);
+    std::atomic<unsigned> visits(0);
+    big.parallel_for_each(
+        [&](const char*, const U& Data) {
+            sum += Data;
+            visits++;
+        },
+        4);
+    cout << "parallel_for_each: " << visits << " items, sums "
+         << (sum == expected ? "match" : "differ") << endl;
+
+    try
+    {
+        big.parallel_for_each(
+            [](const char* Key, const U&) {
+                if (!std::strcmp(Key, "100037"))
+                    throw OAHashTableException(OAHashTableException::E_ITEM_NOT_FOUND, Key);
+            },
+            4);
+    }
+    catch (OAHashTableException& e)
+    {
+        cout << "errno: " << e.code() << ", " << e.what() << endl;
+    }
+}
+
+// Primes past the end of the old lookup table, up to the top of 32 bits
+void TestPrimes()
+{
+    cout << endl << "==================== TestPrimes ====================" << endl;
+
+    const unsigned values[] = {
+        0, 4, 4098, 4100, 4489, 16801818, 2147483648u, 4294967280u, 4294967295u};
+    for (unsigned i = 0; i < sizeof(values) / sizeof(*values); i++)
+        cout << "GetClosestPrime(" << values[i] << ") = " << GetClosestPrime(values[i])
+             << ", GetLadderPrime(" << values[i] << ") = " << GetLadderPrime(values[i]).Divisor_
+             << endl;
+
+    // The ladder's reciprocals are worked out at compile time
+    const FastModulus& rung = GetLadderPrime(1000000);
+    cout << "123456789 % " << rung.Divisor_ << " = " << rung.Reduce(123456789) << " ("
+         << 123456789 % rung.Divisor_ << ")" << endl;
+}
+
 /*
   Why are the hashes so different when the same function is used for
   both primary and secondary hash? e.g. TableSize is 13:
@@ -1115,6 +1605,64 @@ int main(int argc, char** argv)
         TestDoubleHashing(&HashingFuncs[PJW], &HashingFuncs[SIMPLE]);
         break;
 
+    case 14:
+        TestTemplatedKeys();
+        break;
+
+    case 15:
+        TestBatch();
+        break;
+
+    case 16:
+        TestSizing(PRIME);
+        TestSizing(PRIME_FASTMOD);
+        TestSizing(POWER_OF_TWO);
+        break;
+
+    case 17:
+        TestTombstones(0);
+        TestTombstones(0.25);
+        break;
+
+    case 18:
+        TestSnapshot();
+        break;
+
+    case 19:
+        TestProfile(&HashingFuncs[SIMPLE], &HashingFuncs[NONE]);
+        TestProfile(&HashingFuncs[PJW], &HashingFuncs[SIMPLE]);
+        break;
+
+    case 20:
+        TestBulkBuild(PRIME);
+        TestBulkBuild(POWER_OF_TWO);
+        break;
+
+    case 21:
+        TestCuckoo(&HashingFuncs[PJW], &HashingFuncs[RS]);
+        TestCuckoo(&HashingFuncs[WY], &HashingFuncs[XX]);
+        break;
+
+    case 22:
+        TestPerfectHash();
+        break;
+
+    case 23:
+        TestIterate();
+        break;
+
+    case 24:
+        TestPrimes();
+        break;
+
+    case 25:
+        TestSimpleMarkPack(&HashingFuncs[SIMPLE], &HashingFuncs[PJW], PACK);
+        break;
+
+    case 26:
+        TestRehashStride();
+        break;
+
     default:
         TestALot(&HashingFuncs[SIMPLE], &HashingFuncs[NONE]);
         TestSimpleGrow1();
@@ -1130,6 +1678,25 @@ int main(int argc, char** argv)
         TestSimpleMarkPack(&HashingFuncs[SIMPLE], &HashingFuncs[NONE], MARK);
         TestSimpleMarkPack(&HashingFuncs[SIMPLE], &HashingFuncs[PJW], MARK);
         TestDoubleHashing(&HashingFuncs[PJW], &HashingFuncs[SIMPLE]);
+        TestTemplatedKeys();
+        TestBatch();
+        TestSizing(PRIME);
+        TestSizing(PRIME_FASTMOD);
+        TestSizing(POWER_OF_TWO);
+        TestTombstones(0);
+        TestTombstones(0.25);
+        TestSnapshot();
+        TestProfile(&HashingFuncs[SIMPLE], &HashingFuncs[NONE]);
+        TestProfile(&HashingFuncs[PJW], &HashingFuncs[SIMPLE]);
+        TestBulkBuild(PRIME);
+        TestBulkBuild(POWER_OF_TWO);
+        TestCuckoo(&HashingFuncs[PJW], &HashingFuncs[RS]);
+        TestCuckoo(&HashingFuncs[WY], &HashingFuncs[XX]);
+        TestPerfectHash();
+        TestIterate();
+        TestPrimes();
+        TestSimpleMarkPack(&HashingFuncs[SIMPLE], &HashingFuncs[PJW], PACK);
+        TestRehashStride();
         break;
     }
 
@@ -0,0 +1,178 @@
+// Compares the hash functions in HashFuncs.h for distribution quality and
+// throughput on a few kinds of keys. Build with "make -f Makefile2 hashbench".
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "HashFuncs.h"
+#include "OAHashTable.h"
+
+struct HashData
+{
+    HASHFUNC Fn;
+    const char* Name;
+};
+
+HashData HashingFuncs[] = {
+    {ConstantHash, "Constant"},
+    {ReflexiveHash, "Reflexive"},
+    {SimpleHash, "Simple"},
+    {RSHash, "RS"},
+    {UHash, "Universal"},
+    {PJWHash, "PJW"},
+    {WyHash, "Wy"},
+    {XXHash, "XX"}};
+
+const unsigned KEY_COUNT = 50000;
+const unsigned TABLE_SIZE = 100003; // prime, about LF 0.5
+
+// Six digit IDs, like the driver's PEOPLE
+std::vector<std::string> MakeIDKeys()
+{
+    std::vector<std::string> keys;
+    char buffer[16];
+    for (unsigned i = 0; i < KEY_COUNT; i++)
+    {
+        std::sprintf(buffer, "%06u", 100000 + i);
+        keys.push_back(buffer);
+    }
+    return keys;
+}
+
+// Random alphanumeric strings of 8 to 24 characters
+std::vector<std::string> MakeRandomKeys()
+{
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::vector<std::string> keys;
+    for (unsigned i = 0; i < KEY_COUNT; i++)
+    {
+        std::string key;
+        int length = 8 + std::rand() % 17;
+        for (int j = 0; j < length; j++)
+            key += alphabet[std::rand() % (sizeof(alphabet) - 1)];
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Long URL paths that only differ near the end
+std::vector<std::string> MakeURLKeys()
+{
+    std::vector<std::string> keys;
+    char buffer[128];
+    for (unsigned i = 0; i < KEY_COUNT; i++)
+    {
+        std::sprintf(buffer, "https://example.com/api/v2/accounts/%u/settings/profile", i * 7);
+        keys.push_back(buffer);
+    }
+    return keys;
+}
+
+// Keys that land in an already used bucket, and the largest bucket
+void Distribution(
+    HASHFUNC Fn,
+    const std::vector<std::string>& keys,
+    unsigned& collisions,
+    unsigned& worst)
+{
+    std::vector<unsigned> buckets(TABLE_SIZE, 0);
+    collisions = 0;
+    worst = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        unsigned& bucket = buckets[Fn(keys[i].c_str(), TABLE_SIZE)];
+        if (bucket)
+            collisions++;
+        bucket++;
+        if (bucket > worst)
+            worst = bucket;
+    }
+}
+
+// Nanoseconds per key, best of a few runs
+double Throughput(HASHFUNC Fn, const std::vector<const char*>& keys)
+{
+    double best = 0;
+    for (int run = 0; run < 5; run++)
+    {
+        unsigned sink = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keys.size(); i++)
+            sink += Fn(keys[i], TABLE_SIZE);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                    static_cast<double>(keys.size());
+        if (run == 0 || ns < best)
+            best = ns;
+
+        // Keep the loop from being optimized away
+        if (sink == 1)
+            std::printf(" ");
+    }
+    return best;
+}
+
+typedef void (*BATCHFUNC)(const char* const*, std::size_t, unsigned, unsigned*);
+
+double BatchThroughput(BATCHFUNC Fn, const std::vector<const char*>& keys)
+{
+    std::vector<unsigned> indices(keys.size());
+    double best = 0;
+    for (int run = 0; run < 5; run++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Fn(&keys[0], keys.size(), TABLE_SIZE, &indices[0]);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                    static_cast<double>(keys.size());
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+void Compare(const char* title, const std::vector<std::string>& keys)
+{
+    std::vector<const char*> pointers;
+    for (size_t i = 0; i < keys.size(); i++)
+        pointers.push_back(keys[i].c_str());
+
+    // Expected collisions if keys were thrown into buckets uniformly at random
+    double empty = 1.0;
+    for (size_t i = 0; i < keys.size(); i++)
+        empty *= 1.0 - 1.0 / TABLE_SIZE;
+    double expected = static_cast<double>(keys.size()) - TABLE_SIZE * (1.0 - empty);
+
+    std::printf(
+        "\n%s (%u keys, table size %u, %.0f collisions expected)\n",
+        title,
+        static_cast<unsigned>(keys.size()),
+        TABLE_SIZE,
+        expected);
+    std::printf("%-12s %12s %10s %10s\n", "Hash", "Collisions", "Worst", "ns/key");
+
+    unsigned count = sizeof(HashingFuncs) / sizeof(*HashingFuncs);
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned collisions, worst;
+        Distribution(HashingFuncs[i].Fn, keys, collisions, worst);
+        double ns = Throughput(HashingFuncs[i].Fn, pointers);
+        std::printf("%-12s %12u %10u %10.2f\n", HashingFuncs[i].Name, collisions, worst, ns);
+    }
+
+    std::printf("%-12s %34.2f\n", "Wy (batch)", BatchThroughput(WyHashBatch, pointers));
+    std::printf("%-12s %34.2f\n", "XX (batch)", BatchThroughput(XXHashBatch, pointers));
+}
+
+int main()
+{
+    std::srand(1);
+    Compare("Six digit IDs", MakeIDKeys());
+    Compare("Random strings", MakeRandomKeys());
+    Compare("URL paths", MakeURLKeys());
+    return 0;
+}
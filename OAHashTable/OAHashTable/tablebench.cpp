@@ -0,0 +1,274 @@
+// Measures insert, find (hits and misses) and remove throughput of
+// OAHashTable, for tables from a few KB (fits in L1) to well past the last
+// level cache, with every hash function the driver uses and both deletion
+// policies. Writes CSV to stdout, one row per operation, so results can be
+// kept and compared across releases. Build with "make -f Makefile2
+// tablebench" and pass the largest number of keys (default 1M) on
+// the command line.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "HashFuncs.h"
+#include "OAHashTable.h"
+
+typedef OAHashTable<unsigned> Table;
+
+struct HashData
+{
+    HASHFUNC Fn;
+    const char* Name;
+};
+
+HashData HashingFuncs[] = {
+    {ConstantHash, "Constant"},
+    {ReflexiveHash, "Reflexive"},
+    {SimpleHash, "Simple"},
+    {RSHash, "RS"},
+    {UHash, "Universal"},
+    {PJWHash, "PJW"},
+    {WyHash, "Wy"},
+    {XXHash, "XX"}};
+
+//! How the keys look and how often each one is looked up
+enum Distribution
+{
+    UNIFORM, //!< Random keys, each looked up as often as the others
+    ZIPF,    //!< Random keys, a few of them looked up most of the time
+    PREFIX   //!< Keys that only differ after a long common prefix
+};
+
+const char* DISTRIBUTION_NAMES[] = {"uniform", "zipf", "prefix"};
+
+//! Zipf exponent (0.99 is what YCSB uses)
+const double ZIPF_SKEW = 0.99;
+
+//! Probes per operation past which a configuration isn't run at larger sizes
+const double MAX_PROBES = 64;
+
+//! Seconds an operation may take before it's given up on
+const double TIME_BUDGET = 2.0;
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Count keys of the shape of Dist. Salt keeps the hit and miss keys apart.
+std::vector<std::string> MakeKeys(Distribution Dist, size_t Count, char Salt, std::mt19937_64& rng)
+{
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::vector<std::string> keys(Count);
+    char buffer[128];
+    for (size_t i = 0; i < Count; i++)
+    {
+        if (Dist == PREFIX)
+        {
+            // Every key is the same for the first 48 bytes
+            std::sprintf(
+                buffer, "tenant/0001/region/eu-west/bucket/objects/%c/%012zu", Salt, i);
+            keys[i] = buffer;
+        }
+        else
+        {
+            keys[i] = Salt;
+            for (int j = 0; j < 15; j++)
+                keys[i] += alphabet[rng() % (sizeof(alphabet) - 1)];
+        }
+    }
+    return keys;
+}
+
+// Indices of the keys to look up: Count draws from [0, Keys), with Zipf
+// skew (key 0 the most popular) or uniformly
+std::vector<size_t> MakeLookups(Distribution Dist, size_t Keys, size_t Count, std::mt19937_64& rng)
+{
+    std::vector<size_t> lookups(Count);
+    if (Dist != ZIPF)
+    {
+        std::uniform_int_distribution<size_t> uniform(0, Keys - 1);
+        for (size_t i = 0; i < Count; i++)
+            lookups[i] = uniform(rng);
+        return lookups;
+    }
+
+    std::vector<double> cdf(Keys);
+    double total = 0;
+    for (size_t i = 0; i < Keys; i++)
+    {
+        total += 1.0 / std::pow(static_cast<double>(i + 1), ZIPF_SKEW);
+        cdf[i] = total;
+    }
+    std::uniform_real_distribution<double> uniform(0, total);
+    for (size_t i = 0; i < Count; i++)
+    {
+        size_t rank = static_cast<size_t>(
+            std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin());
+        lookups[i] = rank < Keys ? rank : Keys - 1;
+    }
+    return lookups;
+}
+
+// Times Op(i) for i in [0, Count), prints its row and returns the probes
+// per operation. Gives up (returns MAX_PROBES) once TIME_BUDGET has gone by.
+template <typename F>
+double Measure(
+    const char* Operation,
+    Distribution Dist,
+    OAHTDeletionPolicy Policy,
+    const HashData& Hash,
+    size_t Keys,
+    const Table& ht,
+    size_t Count,
+    F Op)
+{
+    unsigned probes = ht.GetStats().Probes_;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < Count; i++)
+    {
+        Op(i);
+        if (i % 256 == 255 && Seconds(start) > TIME_BUDGET)
+        {
+            std::fprintf(
+                stderr,
+                "gave up on %s %s %s %s at %zu keys (over %.0f s)\n",
+                Operation,
+                DISTRIBUTION_NAMES[Dist],
+                Policy == MARK ? "MARK" : "PACK",
+                Hash.Name,
+                Keys,
+                TIME_BUDGET);
+            return MAX_PROBES;
+        }
+    }
+    double seconds = Seconds(start);
+    double perOp = static_cast<double>(ht.GetStats().Probes_ - probes) / static_cast<double>(Count);
+
+    std::printf(
+        "%s,%s,%s,%s,%zu,%u,%.2f,%.3f\n",
+        Operation,
+        DISTRIBUTION_NAMES[Dist],
+        Policy == MARK ? "MARK" : "PACK",
+        Hash.Name,
+        Keys,
+        ht.GetStats().TableSize_,
+        seconds * 1e9 / static_cast<double>(Count),
+        perOp);
+    return perOp;
+}
+
+// Runs the four operations on Count keys. Returns the most probes per
+// operation any of them took (or MAX_PROBES if one ran out of time).
+double Run(
+    Distribution Dist,
+    OAHTDeletionPolicy Policy,
+    const HashData& Hash,
+    size_t Count,
+    const std::vector<const char*>& hits,
+    const std::vector<const char*>& misses,
+    const std::vector<size_t>& lookups,
+    const std::vector<size_t>& removals)
+{
+    // MaxDeletedFactor 0: MARK tables keep their tombstones, as remove left them
+    Table ht(Table::OAHTConfig(7, Hash.Fn, 0, 0.5, 2.0, Policy, 0, PRIME, 0));
+    unsigned long long sink = 0;
+
+    double worst = Measure("insert", Dist, Policy, Hash, Count, ht, Count, [&](size_t i) {
+        ht.insert(hits[i], static_cast<unsigned>(i));
+    });
+    if (worst < MAX_PROBES)
+    {
+        worst = std::max(
+            worst,
+            Measure("find_hit", Dist, Policy, Hash, Count, ht, lookups.size(), [&](size_t i) {
+                sink += ht.find(hits[lookups[i]]);
+            }));
+
+        // A miss makes find throw, which costs more than the probing, so
+        // misses go through find_batch (0 for a missing key) one at a time
+        worst = std::max(
+            worst,
+            Measure("find_miss", Dist, Policy, Hash, Count, ht, lookups.size(), [&](size_t i) {
+                const unsigned* found;
+                ht.find_batch(&misses[lookups[i]], 1, &found);
+                sink += found ? *found : 1;
+            }));
+
+        worst = std::max(
+            worst, Measure("remove", Dist, Policy, Hash, Count, ht, Count, [&](size_t i) {
+                ht.remove(hits[removals[i]]);
+            }));
+    }
+
+    // Keep the finds from being optimized away
+    if (sink == 1)
+        std::fprintf(stderr, " ");
+    return worst;
+}
+
+int main(int argc, char** argv)
+{
+    size_t largest = 1u << 20;
+    if (argc > 1)
+        largest = static_cast<size_t>(std::atol(argv[1]));
+
+    // Tables end between LF 0.25 and 0.5 with 24 byte slots: 256 keys take
+    // 12 to 24 KB (L1), 1M keys 48 to 96 MB (past the last level cache)
+    std::vector<size_t> sizes;
+    for (size_t count = 256; count <= largest; count *= 8)
+        sizes.push_back(count);
+
+    std::printf("operation,distribution,policy,hash,keys,table_size,ns_per_op,probes_per_op\n");
+
+    const OAHTDeletionPolicy policies[] = {MARK, PACK};
+    unsigned hashCount = sizeof(HashingFuncs) / sizeof(*HashingFuncs);
+    for (int dist = UNIFORM; dist <= PREFIX; dist++)
+    {
+        Distribution d = static_cast<Distribution>(dist);
+        std::mt19937_64 rng(1);
+        std::vector<std::string> hitStrings = MakeKeys(d, largest, 'h', rng);
+        std::vector<std::string> missStrings = MakeKeys(d, largest, 'm', rng);
+
+        // The weak hashes make long clusters, and the operations get slower
+        // with every size (quadratic or worse), so they stop early
+        std::vector<bool> overBudget(2 * hashCount, false);
+        for (size_t s = 0; s < sizes.size(); s++)
+        {
+            size_t count = sizes[s];
+            std::vector<const char*> hits(count), misses(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                hits[i] = hitStrings[i].c_str();
+                misses[i] = missStrings[i].c_str();
+            }
+            std::vector<size_t> lookups = MakeLookups(d, count, count, rng);
+            std::vector<size_t> removals(count);
+            for (size_t i = 0; i < count; i++)
+                removals[i] = i;
+            std::shuffle(removals.begin(), removals.end(), rng);
+
+            for (unsigned p = 0; p < 2; p++)
+            {
+                for (unsigned h = 0; h < hashCount; h++)
+                {
+                    if (overBudget[p * hashCount + h])
+                    {
+                        continue;
+                    }
+
+                    const HashData& hash = HashingFuncs[h];
+                    double probes =
+                        Run(d, policies[p], hash, count, hits, misses, lookups, removals);
+                    overBudget[p * hashCount + h] = probes >= MAX_PROBES;
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+    return 0;
+}